@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Serial console: line-based text commands, plus binary frames for bulk
+// transfers such as the history export. A binary frame is
+//   0xA5 0x5A | type | len (u16 LE) | payload | crc16 (u16 LE)
+// with the CRC (see crc.h) covering type, len and payload.
+
+#define CONSOLE_SOF0 0xA5
+#define CONSOLE_SOF1 0x5A
+#define CONSOLE_LINE_MAX 96
+#define CONSOLE_MAX_COMMANDS 24
+#define CONSOLE_MAX_ARGS 8
+
+enum ConsoleFrameType : uint8_t {
+  FRAME_HISTORY_BEGIN = 0x01,
+  FRAME_HISTORY_DATA = 0x02,
+  FRAME_HISTORY_END = 0x03,
+  FRAME_OTA_DATA = 0x10,   // Host to device: next piece of a firmware patch
+  FRAME_OTA_ACK = 0x11,    // Device to host: bytes received (u32), status (i32, OtaStatus)
+};
+
+typedef void (*ConsoleHandler)(int argc, char **argv);
+
+// Last binary transfer, measured from console_begin_binary() until the last
+// byte has left the UART
+struct ConsoleTransfer {
+  uint32_t bytes;
+  uint32_t us;
+  uint32_t baud;
+};
+
+// Starts the console UART at CONSOLE_BAUD and registers the `baud` command
+void console_begin();
+
+// Commands are registered once at startup, before console_task runs
+void console_register(const char *name, const char *help, ConsoleHandler fn);
+void console_task(void *pvParameters);
+
+// Binary transfer. Text logging is muted between begin and end. The payload
+// is written straight from the caller's memory (which may be memory-mapped
+// flash), there is no staging copy.
+void console_begin_binary();
+void console_send_frame(uint8_t type, const void *payload, uint16_t len);
+void console_end_binary();
+// Receives one frame into payload (at most maxLen bytes). Returns the payload
+// length, or -1 on timeout, CRC error or an oversized frame.
+int console_read_frame(uint8_t *type, uint8_t *payload, uint16_t maxLen, uint32_t timeoutMs);
+void console_last_transfer(ConsoleTransfer *out);
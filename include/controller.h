@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// Humidifier controller: sensor and water level inputs, the valve/pump
+// decisions and the control log. It only talks to hal.h and the pumps, gains,
+// kpi, coord and history modules, so the same code runs in the FreeRTOS tasks
+// of main.cpp and in the host simulator (sim/).
+
+#define VALVE_PIN 26
+#define WATER_LEVEL_PIN 35   // Float switch, HIGH = empty
+
+// Pump cycle (pins and PWM settings are in pumps.h)
+#define PUMP_CYCLE_S 120         // One pump run + wait cycle (standalone duty comes from gains.h)
+#define VALVE_FILL_S 180         // Valve open time per refill
+
+// Water level detection
+#define DEBOUNCE_COUNT 10  // Number of consecutive reads needed to change state
+
+#define HUMIDITY_OFFSET -10.0  // Adjust based on comparison with reference
+#define HUMIDITY_PRESET 50.0  // Preset value for humidity
+
+#define CONTROL_SNAPSHOT_S 600    // Control log snapshot when nothing else was logged
+#define CONTROL_DUTY_STEP 10      // Coordinator duty change (%) worth a control log record
+
+enum PumpState { PUMP_IDLE, PUMP_RUNNING, PUMP_WAITING };
+
+// Controller state, read by the display and history tasks
+extern float temperature;
+extern float humidity;
+extern bool waterEmpty;
+extern bool valveActive;
+extern bool pumpActive;
+extern int countdown;
+extern bool valveHasRun;
+extern bool targetReached;
+extern PumpState pumpState;
+extern int pumpRunTime;
+
+// Valve output, pump channels, KPIs and gains
+void controller_begin();
+
+// One good sensor reading, before HUMIDITY_OFFSET
+void controller_reading(float temp, float hum);
+
+// One water level input sample, HIGH = empty; debounced over DEBOUNCE_COUNT samples
+void controller_level(int level);
+
+// One control tick covering `seconds` whole seconds (0 is fine for fast periods)
+void controller_tick(int seconds);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+// Multi-unit coordination over a shared RS-485 bus (half duplex, DE pin).
+//
+// Unit 1 is the master: every COORD_PERIOD_MS it polls units 2..COORD_MAX_UNITS,
+// each poll carrying that unit's assigned pump duty and whether the house has
+// reached the preset, and each reply carrying the unit's humidity, water state
+// and pump runtime. The master averages the humidity readings and splits the
+// demand between units (coord_assign). A zero duty alone does not mean the
+// house is at the preset: a unit that is empty or refilling gets none either.
+// A unit that has not been polled for COORD_TIMEOUT_MS falls back to running
+// on its own sensor, as does every unit when COORD_UNIT_ID is 0.
+//
+// Bus frame: 0xA5 0x5A | dst | src | type | len | payload | crc16 (LE)
+// with the CRC covering dst..payload.
+
+#ifndef COORD_UNIT_ID
+#define COORD_UNIT_ID 0      // 0 = standalone, 1 = master, 2.. = slaves (set via build_flags)
+#endif
+
+#define COORD_UART 2
+#define COORD_TX_PIN 17
+#define COORD_RX_PIN 16
+#define COORD_DE_PIN 4       // RS-485 transceiver driver enable
+#define COORD_BAUD 115200
+
+#define COORD_MASTER_ID 1
+#define COORD_MAX_UNITS 4
+#define COORD_PERIOD_MS 2000
+#define COORD_REPLY_MS 30
+#define COORD_MAX_MISSES 3   // Polls without reply before a unit counts as offline
+#define COORD_TIMEOUT_MS 10000
+#define COORD_GAIN_PCT 50    // Total duty (% of one unit) per 1 %RH below preset
+#define COORD_RUNTIME_BIAS_MIN 600  // Weight floor, so the most worn unit still gets a share
+
+struct CoordStatus {
+  int16_t humidity;     // 0.1 %RH, <= 0 when the sensor has no reading
+  uint8_t waterEmpty;
+  uint8_t filling;      // Valve open
+  uint32_t runtimeMin;  // Total pump runtime
+} __attribute__((packed));
+
+struct CoordPoll {
+  uint8_t duty;         // Percent
+  uint8_t atTarget;     // House average at or above the preset
+} __attribute__((packed));
+
+struct CoordUnit {
+  bool online;
+  uint8_t misses;
+  CoordStatus status;
+};
+
+// preset in 0.1 %RH, only used by the master
+void coord_begin(uint8_t unitId, int16_t preset);
+void coord_task(void *pvParameters);
+
+// Called by control_task every tick with this unit's state
+void coord_set_local(const CoordStatus *status);
+
+// Assigned pump duty in percent, or -1 when running standalone
+int coord_pump_duty();
+
+// The master's target decision; only meaningful while coord_pump_duty() >= 0
+bool coord_at_target();
+
+// One bus exchange: coord_task calls these in a loop on the master and the
+// slaves respectively
+void coord_master_round();
+void coord_slave_poll();
+
+// Splits the humidity deficit between eligible units (online, tank OK, not
+// filling), weighting units with fewer runtime hours more. Returns true when
+// the house is at target, or no unit has a reading; the duties are then all
+// zero. The target is reached at the preset, and once reached (atTarget, the
+// previous result) held until the house average drops hysteresis (in 0.1 %RH)
+// below it, as a standalone unit does. Pure function (coord_assign.cpp).
+bool coord_assign(const CoordUnit *units, int n, int16_t preset, int16_t hysteresis, bool atTarget,
+                  uint8_t *duty);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16/CCITT-FALSE (poly 0x1021), used for history records and console frames.
+// Pass the previous result as crc to continue over several buffers.
+uint16_t crc16_ccitt(const void *data, size_t len, uint16_t crc = 0xFFFF);
+
+// CRC-8 poly 0x31, init 0xFF (Sensirion and Aosong humidity sensors)
+uint8_t crc8_sensor(const void *data, size_t len);
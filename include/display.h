@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+// Display stack: a 1 bpp canvas with the 5x7 text renderer, a dirty-region
+// tracker shared by all panels, and a DisplayPanel backend per controller
+// (display_panels.h). The canvas keeps the SSD1306 page layout: one byte is
+// 8 vertical pixels, pages are 8 rows tall.
+//
+// On display() the canvas is compared against what was last sent, and only
+// the changed columns of each page go to the panel. Redrawing the whole
+// screen every second therefore costs bus time only for what changed.
+
+#define DISPLAY_BLACK 0
+#define DISPLAY_WHITE 1
+#define DISPLAY_MAX_PAGES 8   // Up to 64 rows
+
+// Changed columns per page, inclusive; x0 > x1 means the page is clean
+struct DisplayDirty {
+  int16_t x0[DISPLAY_MAX_PAGES];
+  int16_t x1[DISPLAY_MAX_PAGES];
+  int pages;
+};
+
+class DisplayPanel {
+ public:
+  DisplayPanel(int width, int height) : w(width), h(height) {}
+  virtual ~DisplayPanel() {}
+
+  virtual bool begin() = 0;
+  virtual void setContrast(uint8_t level) = 0;
+  // Sends the dirty parts of the 1 bpp page-layout canvas (fb, w bytes per page)
+  virtual void flush(const uint8_t *fb, const DisplayDirty &dirty) = 0;
+
+  int width() const { return w; }
+  int height() const { return h; }
+  uint32_t bytesSent() const { return sent; }
+
+ protected:
+  int w, h;
+  uint32_t sent = 0;  // Payload bytes pushed to the controller, for the display stats
+};
+
+class Display {
+ public:
+  explicit Display(DisplayPanel *panel);
+  ~Display();
+
+  bool begin();
+  void setContrast(uint8_t level) { panel->setContrast(level); }
+  void display();
+  void clearDisplay();
+
+  void drawPixel(int x, int y, int color);
+  void setTextSize(int size) { textSize = size > 0 ? size : 1; }
+  void setTextColor(int color) { textColor = color; }
+  void setCursor(int x, int y) { cursorX = x; cursorY = y; }
+  void print(const char *s);
+  void println(const char *s);
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  int width() const { return w; }
+  int height() const { return h; }
+  uint32_t frames() const { return frameCount; }
+  uint32_t bytesSent() const { return panel->bytesSent(); }
+
+ private:
+  void drawChar(int x, int y, char c);
+  bool findDirty(DisplayDirty *dirty);
+
+  DisplayPanel *panel;
+  int w, h;
+  uint8_t *buffer = nullptr;  // Canvas being drawn
+  uint8_t *shadow = nullptr;  // What the panel currently shows
+  bool forceFull = true;
+  uint32_t frameCount = 0;
+  int cursorX = 0, cursorY = 0;
+  int textSize = 1;
+  int textColor = DISPLAY_WHITE;
+};
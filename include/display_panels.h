@@ -0,0 +1,62 @@
+#pragma once
+
+#include "display.h"
+
+// Panel backends. Pick one with the DISPLAY_PANEL build flag.
+//   PANEL_SSD1306  128x64 mono, I2C (default, the original OLED)
+//   PANEL_SH1106   128x64 mono, I2C, 132-column RAM, page addressing only
+//   PANEL_SSD1322  256x64 4-bit grayscale, 4-wire SPI
+
+#define PANEL_SSD1306 1
+#define PANEL_SH1106 2
+#define PANEL_SSD1322 3
+
+#ifndef DISPLAY_PANEL
+#define DISPLAY_PANEL PANEL_SSD1306
+#endif
+
+// SSD1322 wiring (SPI)
+#define SSD1322_SCK_PIN 18
+#define SSD1322_MOSI_PIN 23
+#define SSD1322_CS_PIN 5
+#define SSD1322_DC_PIN 19
+#define SSD1322_RST_PIN 15
+#define SSD1322_SPI_HZ 10000000
+
+class Ssd1306Panel : public DisplayPanel {
+ public:
+  Ssd1306Panel(int width, int height, uint8_t addr) : DisplayPanel(width, height), i2caddr(addr) {}
+  bool begin() override;
+  void setContrast(uint8_t level) override;
+  void flush(const uint8_t *fb, const DisplayDirty &dirty) override;
+
+ protected:
+  void commandList(const uint8_t *cmds, int n);
+  void sendData(const uint8_t *data, int n);
+
+  uint8_t i2caddr;
+};
+
+class Sh1106Panel : public Ssd1306Panel {
+ public:
+  Sh1106Panel(int width, int height, uint8_t addr) : Ssd1306Panel(width, height, addr) {}
+  bool begin() override;
+  void flush(const uint8_t *fb, const DisplayDirty &dirty) override;
+};
+
+class Ssd1322Panel : public DisplayPanel {
+ public:
+  Ssd1322Panel(int width, int height) : DisplayPanel(width, height) {}
+  bool begin() override;
+  void setContrast(uint8_t level) override;
+  void flush(const uint8_t *fb, const DisplayDirty &dirty) override;
+
+  // Gray level (0-15) used for lit pixels
+  void setForeground(uint8_t level);
+
+ private:
+  void command(uint8_t cmd, const uint8_t *args = nullptr, int n = 0);
+  void sendBand(const uint8_t *fb, int page0, int page1, int x0, int x1);
+
+  uint8_t lut[4];  // 2 mono pixels -> one 4bpp byte
+};
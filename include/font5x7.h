@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#define FONT5X7_FIRST 0x20
+#define FONT5X7_COUNT 95
+#define FONT5X7_WIDTH 5
+#define FONT5X7_HEIGHT 7
+
+extern const uint8_t font5x7[FONT5X7_COUNT][5];
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Gain scheduling for the standalone humidity controller.
+//
+// Early winter needs little water, deep winter (drier outdoor air, more air
+// exchange) a lot more. There is no outdoor sensor, so the scheduling variable
+// is the learned load: an exponential average of the share of time the pumps
+// run (time constant GAIN_LOAD_TAU_S, kept in NVS). Each tick the active gain
+// set is interpolated between the two stored sets around that load.
+
+#define GAIN_LOAD_TAU_S 21600      // 6 h
+#define GAIN_SAVE_PERIOD_S 3600    // Learned load is saved to NVS hourly
+
+struct GainSet {
+  int16_t load;         // Scheduling point, permille of time pumping
+  uint8_t baseDuty;     // Pump duty (%) right below the preset
+  uint8_t kp;           // Extra duty (%) per %RH below the preset
+  uint8_t hysteresis;   // 0.1 %RH below preset before pumping resumes
+  uint8_t lagDeficit;   // %RH below preset per additional parallel pump
+};
+
+// Stored gain sets, light load (early winter) to heavy load (deep winter),
+// sorted by load
+#define GAIN_POINTS 3
+#define GAIN_TABLE { \
+  {100, 35, 10, 10, 8}, \
+  {350, 50, 15, 5, 5},  \
+  {700, 65, 25, 3, 3},  \
+}
+
+void gains_begin();
+
+// Once per control tick; pumping = at least one pump running
+void gains_tick(bool pumping);
+
+int16_t gains_load();
+uint32_t gains_load_q16();   // Full precision, for the control log
+void gains_current(GainSet *out);
+
+// Linear interpolation between the bracketing table entries, clamped at the
+// ends. Pure function, integer math.
+void gains_interpolate(const GainSet *table, int n, int16_t load, GainSet *out);
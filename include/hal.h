@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin board layer shared by both builds.
+//   esp32dev     (Arduino): Wire, ledc and digitalWrite from the Arduino core
+//   esp32dev-idf (ESP-IDF): i2c_master, ledc, gpio and esp_timer drivers directly
+// Everything above this header (drivers, tasks) is framework independent.
+
+#ifndef HIGH
+#define HIGH 1
+#define LOW 0
+#endif
+
+// Largest single I2C write the backend accepts in one transaction.
+// Arduino's Wire buffer is 128 bytes, the IDF driver has no such limit.
+#ifdef ARDUINO
+#define HAL_I2C_MAX_WRITE 128
+#else
+#define HAL_I2C_MAX_WRITE 1040
+#endif
+
+// Console on UART0 through the IDF UART driver in both builds
+// (hal_console.cpp): the RX interrupt feeds a ring buffer and an event
+// queue, writes go into a TX ring buffer that the TX-empty interrupt drains
+// into the 128-byte FIFO, so callers only block while the ring is full.
+#define CONSOLE_BAUD 115200
+#define CONSOLE_BAUD_MAX 2000000   // Limit of common USB-UART bridges (CP2102N, CH340)
+#define CONSOLE_RX_BUF 2048        // Room for a whole OTA frame while the task writes flash
+#define CONSOLE_TX_BUF 8192        // Eight 1 KB history frames in flight
+#define CONSOLE_TX_CHUNK 2048      // Largest piece copied into the ring at once
+#define CONSOLE_EVENT_QUEUE 16
+
+struct ConsoleStats {
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  uint32_t rxOverflows;   // RX FIFO or ring overflowed, input was dropped
+  uint64_t txBlockedUs;   // Time writers waited for room in the TX ring
+};
+
+void hal_console_begin(uint32_t baud);
+void hal_console_write(const void *data, size_t len);
+// Waits up to timeoutMs for input, returns number of bytes read (0 on timeout)
+size_t hal_console_read(uint8_t *data, size_t maxLen, uint32_t timeoutMs);
+void hal_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+// While quiet, hal_printf output is dropped so binary transfers stay intact
+void hal_console_set_quiet(bool quiet);
+// Waits until everything written has left the UART, false on timeout
+bool hal_console_flush(uint32_t timeoutMs);
+// Drains pending output, then switches; false if baud is out of range
+bool hal_console_set_baud(uint32_t baud);
+uint32_t hal_console_baud();
+void hal_console_get_stats(ConsoleStats *out);
+
+// Time
+uint32_t hal_millis();
+int64_t hal_micros();
+void hal_delay_ms(uint32_t ms);
+
+// GPIO
+void hal_gpio_input(int pin);
+void hal_gpio_output(int pin, int level);
+void hal_gpio_write(int pin, int level);
+int hal_gpio_read(int pin);
+
+// Auxiliary UARTs (1 or 2), e.g. the RS-485 link
+bool hal_uart_begin(int port, int txPin, int rxPin, uint32_t baud);
+// Blocks until the last byte has left the shift register
+void hal_uart_write(int port, const void *data, size_t len);
+size_t hal_uart_read(int port, uint8_t *data, size_t maxLen, uint32_t timeoutMs);
+
+// PWM (LEDC, low speed mode)
+void hal_pwm_init(int pin, int channel, uint32_t freq, int resolutionBits);
+void hal_pwm_write(int channel, uint32_t duty);
+// Duty the channel is actually running with (read from the LEDC registers)
+uint32_t hal_pwm_read(int channel);
+
+// I2C master, one bus
+bool hal_i2c_begin(int sda, int scl, uint32_t hz);
+bool hal_i2c_probe(uint8_t addr);
+bool hal_i2c_write(uint8_t addr, const uint8_t *data, size_t len);
+bool hal_i2c_read(uint8_t addr, uint8_t *data, size_t len);
+
+// SPI master, one write-only device (chip select handled here)
+bool hal_spi_begin(int sckPin, int mosiPin, int csPin, uint32_t hz);
+void hal_spi_write(const void *data, size_t len);
+
+// Per-transaction bus statistics, used to compare the two builds
+struct I2cStats {
+  uint32_t transactions;
+  uint32_t errors;
+  uint32_t bytes;
+  uint64_t busyUs;   // Total time spent inside transactions
+  uint32_t maxUs;    // Longest single transaction
+};
+
+void hal_i2c_get_stats(I2cStats *out);
+void hal_i2c_reset_stats();
+
+// Called by the backends after every transaction
+void hal_i2c_account(int64_t startUs, size_t bytes, bool ok);
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdint.h>
+
+// Telemetry log in the "history" flash partition (see partitions.csv).
+// Fixed-size records are appended to a ring of 4 KB sectors; the oldest
+// sector is erased when the ring wraps. Export maps the partition with
+// esp_partition_mmap and streams the records out as console frames without
+// copying them into RAM.
+
+#define HISTORY_RECORD_SIZE 32
+#define HISTORY_SECTOR_SIZE 4096
+#define HISTORY_PER_SECTOR (HISTORY_SECTOR_SIZE / HISTORY_RECORD_SIZE)
+#define HISTORY_FRAME_RECORDS 32  // Records per export frame (1 KB payload)
+#define HISTORY_SAMPLE_S 60       // One HISTORY_SAMPLE per minute (history_task)
+
+enum HistoryType : uint8_t {
+  HISTORY_SAMPLE = 1,
+  HISTORY_EVENT = 2,
+  HISTORY_KPI = 3,     // Daily comfort/efficiency roll-up, see kpi.h
+  HISTORY_CONTROL = 4, // Controller decision or snapshot, full state after it
+};
+
+// HistoryEvent.code
+enum HistoryEventCode : uint16_t {
+  EVENT_BOOT = 1,       // arg: 1 = self-test passed, value: ms from reset to end of setup
+  EVENT_SELFTEST = 2,   // arg: SelfTestResult, value: test detail, text: test name
+  EVENT_SAFETY = 3,     // arg: SafetyFault, value: measured reaction of this trip in us
+  EVENT_OTA = 4,        // arg: OtaEvent, value: OtaStatus or image size, text: slot
+};
+
+// HistoryControl.event. Every record holds the complete controller state
+// after the event, so replay starts from any of them; between records only
+// the countdown and the learned load move, both deterministically.
+enum ControlEventCode : uint8_t {
+  CONTROL_SNAPSHOT = 0,      // Periodic, nothing changed
+  CONTROL_START = 1,         // First tick after boot
+  CONTROL_TARGET = 2,        // Target reached or lost
+  CONTROL_WATER = 3,         // Water level input changed
+  CONTROL_DUTY = 4,          // Coordinator duty changed
+  CONTROL_VALVE_START = 5,
+  CONTROL_VALVE_STOP = 6,
+  CONTROL_PUMP_START = 7,
+  CONTROL_PUMP_STOP = 8,     // Run part of the cycle done, waiting
+  CONTROL_PUMP_ABORT = 9,    // Stopped for the valve or an empty tank
+  CONTROL_WAIT_DONE = 10,
+  CONTROL_SAFETY = 11,       // Safety supervisor latched a fault, everything off
+};
+
+// HistoryControl.bits
+#define CONTROL_BIT_VALVE 0x01
+#define CONTROL_BIT_VALVE_HAS_RUN 0x02
+#define CONTROL_BIT_TARGET 0x04
+#define CONTROL_BIT_WATER_EMPTY 0x08
+#define CONTROL_BIT_PUMP 0x10
+
+// HistoryRecord.flags
+#define HISTORY_FLAG_PUMP 0x01
+#define HISTORY_FLAG_VALVE 0x02
+#define HISTORY_FLAG_WATER_EMPTY 0x04
+
+struct HistorySample {
+  int16_t humidity;     // 0.1 %RH, offset applied
+  int16_t temperature;  // 0.1 C
+  int16_t preset;       // 0.1 %RH
+  uint16_t countdown;   // Seconds left in the current valve/pump phase
+  uint8_t pumpState;
+  uint8_t reserved[11];
+};
+
+struct HistoryEvent {
+  uint16_t code;
+  int16_t arg;
+  int32_t value;
+  char text[12];
+};
+
+struct HistoryKpi {
+  uint16_t inBandPermille;  // Share of the day within KPI_BAND of the preset
+  int16_t maxOvershoot;     // 0.1 %RH above preset
+  uint32_t overshootArea;   // 0.1 %RH * s above preset
+  uint32_t waterMl;         // Estimated from pump runtime
+  uint32_t rhHours;         // 0.1 %RH * h of humidity held
+  uint16_t pumpStarts;
+  uint16_t pumpMinutes;
+};
+
+struct HistoryControl {
+  uint8_t event;        // ControlEventCode
+  uint8_t pumpState;
+  uint8_t pumps;        // Channels running
+  uint8_t bits;         // CONTROL_BIT_*
+  int16_t countdown;    // Seconds left in the current valve/pump phase
+  int16_t pumpRunTime;  // Run part of the current pump cycle, seconds
+  int16_t humidity;     // Input: 0.1 %RH, offset applied
+  int8_t duty;          // Input: coordinator duty %, -1 standalone
+  uint8_t reserved;
+  uint32_t loadQ16;     // Learned load, see gains.h
+  uint8_t reserved2[4];
+};
+
+struct HistoryRecord {
+  uint32_t seq;     // Monotonic across reboots; 0xFFFFFFFF means erased
+  uint32_t uptime;  // Seconds since boot
+  union {
+    HistorySample sample;
+    HistoryEvent event;
+    HistoryKpi kpi;
+    HistoryControl control;
+    uint8_t raw[20];
+  };
+  uint8_t type;     // HistoryType
+  uint8_t flags;
+  uint16_t crc;     // crc16_ccitt over all preceding bytes
+};
+
+static_assert(sizeof(HistoryRecord) == HISTORY_RECORD_SIZE, "history record layout");
+
+// Export frame payloads (FRAME_HISTORY_BEGIN / FRAME_HISTORY_END)
+struct HistoryExportInfo {
+  uint32_t count;
+  uint32_t firstSeq;
+  uint16_t recordSize;
+  uint16_t perFrame;
+};
+
+struct HistoryExportDone {
+  uint32_t sent;
+  uint32_t elapsedMs;
+};
+
+// Aggregates over a range of the log. Every flash sector keeps one of these
+// in RAM as a block summary, and a segment tree over the sectors combines
+// them, so a range query touches O(log n) tree nodes plus the partly covered
+// sectors at both ends. Humidity and temperature come from HISTORY_SAMPLE
+// records, pump starts from HISTORY_CONTROL records.
+struct HistoryStats {
+  uint16_t samples;
+  int16_t humidityMin;     // 0.1 %RH
+  int16_t humidityMax;
+  int32_t humiditySum;
+  int16_t temperatureMin;  // 0.1 C
+  int16_t temperatureMax;
+  int32_t temperatureSum;
+  uint16_t pumpSamples;    // Samples with the pump running
+  uint16_t valveSamples;
+  uint16_t pumpStarts;
+};
+
+// Combines two summaries; pure, also used on the host
+void history_stats_clear(HistoryStats *s);
+void history_stats_merge(HistoryStats *into, const HistoryStats &other);
+void history_stats_add(HistoryStats *into, const HistoryRecord &rec);
+
+// Log time: seconds of powered time, continued across reboots (there is no
+// RTC). history_now() is the log time of a record appended now.
+uint32_t history_now();
+
+// Aggregates over records with log time in [from, to]
+bool history_query(uint32_t from, uint32_t to, HistoryStats *out);
+
+// Finds the partition, locates the write head, builds the block summaries
+// and registers the "history" command
+bool history_begin();
+
+// Fills in seq, uptime and crc, then writes the record
+bool history_append(HistoryRecord *rec);
+
+// Appends a HISTORY_EVENT record; text is truncated to 11 characters
+bool history_log_event(uint16_t code, int16_t arg, int32_t value, const char *text);
+
+uint32_t history_count();
+uint32_t history_capacity();
+
+// Streams every stored record, oldest first, as console frames
+bool history_export();
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "history.h"
+
+// Comfort and efficiency KPIs, accumulated with integer math once per
+// control tick and rolled up every KPI_DAY_S into a HISTORY_KPI record:
+//   - time within +-KPI_BAND of the preset
+//   - overshoot above the preset (peak and %RH-seconds)
+//   - water used per %RH-hour held: pump runtime * PUMP_FLOW_ML_PER_MIN
+//     over the time integral of humidity
+//   - pump starts per day
+// There is no RTC, so a "day" is KPI_DAY_S of uptime.
+
+#define KPI_BAND 30                // 0.1 %RH, +-3 %RH around the preset
+#define KPI_DAY_S 86400
+#define PUMP_FLOW_ML_PER_MIN 100   // Per pump channel at 85% PWM
+
+struct KpiAccumulator {
+  uint32_t seconds;        // Ticks with a valid humidity reading
+  uint32_t inBandS;
+  uint32_t overshootArea;  // 0.1 %RH * s
+  int16_t maxOvershoot;    // 0.1 %RH
+  uint32_t rhSeconds;      // 0.1 %RH * s, at most 1000 * 86400
+  uint32_t pumpSeconds;    // Summed over running channels
+  uint32_t startsBase;     // pumps_total_starts() when the day began
+  uint32_t starts;
+  uint32_t elapsedS;       // All ticks, valid reading or not
+};
+
+// pumpStartsTotal: pumps_total_starts() at boot, so the first day starts at zero
+void kpi_begin(uint32_t pumpStartsTotal);
+
+// One control tick (1 s): humidity and preset in 0.1 %RH, humidity <= 0 while
+// there is no reading yet
+void kpi_tick(int16_t humidity, int16_t preset, int pumpsRunning, uint32_t pumpStartsTotal);
+
+// Converts a day's accumulator into its history payload
+void kpi_summarize(const KpiAccumulator *acc, HistoryKpi *out);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+// Firmware update over the serial console, with A/B slots and rollback.
+//
+// tools/fw_delta.py builds a patch against the image the unit is running
+// and sends it with `ota begin <bytes>` in acknowledged FRAME_OTA_DATA
+// frames. The patch is applied as it streams in: the deflate stream is
+// inflated (ROM tinfl), ADD ops read the running slot and add the patch
+// bytes, INSERT ops copy new bytes, and the result goes straight into the
+// inactive OTA slot. Then the new image's SHA-256 and the IDF image checks
+// must pass before the slot is made the boot slot.
+//
+// The new image boots on trial. It must stay healthy for OTA_HEALTH_S (see
+// ota_begin) to be confirmed. Otherwise, or if it resets OTA_TRIAL_BOOTS
+// times before that, the unit boots the previous slot again. The IDF
+// bootloader also rolls back a trial image that resets before confirming
+// (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE); the boot counter covers a
+// bootloader built without rollback support.
+
+#define OTA_PATCH_MAGIC 0x31504448   // "HDP1"
+#define OTA_FRAME_MAX 1024
+#define OTA_FRAME_TIMEOUT_MS 5000
+#define OTA_HEALTH_S 120
+#define OTA_TRIAL_BOOTS 3
+
+// Patch header, followed by a raw deflate stream of ops
+struct OtaPatchHeader {
+  uint32_t magic;
+  uint32_t oldSize;   // 0 for a full image
+  uint32_t newSize;
+  uint32_t reserved;
+  uint8_t oldSha256[32];
+  uint8_t newSha256[32];
+};
+
+enum OtaOp : uint8_t {
+  OTA_OP_END = 0,
+  OTA_OP_ADD = 1,      // src u32, len u32, len bytes added to the running image
+  OTA_OP_INSERT = 2,   // len u32, len bytes
+};
+
+enum OtaStatus : int32_t {
+  OTA_OK = 0,
+  OTA_ERR_BUSY = -1,
+  OTA_ERR_HEADER = -2,
+  OTA_ERR_BASE = -3,      // Patch is for a different running image
+  OTA_ERR_SIZE = -4,
+  OTA_ERR_INFLATE = -5,
+  OTA_ERR_PATCH = -6,     // Bad op or out-of-range source
+  OTA_ERR_FLASH = -7,
+  OTA_ERR_VERIFY = -8,
+  OTA_ERR_TIMEOUT = -9,
+  OTA_ERR_FRAME = -10,
+};
+
+// EVENT_OTA arg
+enum OtaEvent : int16_t {
+  OTA_EVENT_WRITTEN = 1,     // New image verified and set as boot slot
+  OTA_EVENT_FAILED = 2,      // Update aborted, value = OtaStatus
+  OTA_EVENT_TRIAL = 3,       // Booted a trial image, value = boots left
+  OTA_EVENT_CONFIRMED = 4,
+  OTA_EVENT_ROLLBACK = 5,    // Trial image failed its health check
+  OTA_EVENT_ROLLED_BACK = 6, // Running the previous image again after a rollback
+};
+
+// Returns true when the running image works: checked OTA_HEALTH_S after a
+// trial boot
+typedef bool (*OtaHealthFn)();
+
+// Call early in setup, once NVS and the history log are up. Handles a trial
+// boot (boot counter, health check task) and registers the `ota` command.
+void ota_begin(OtaHealthFn healthy);
+
+// True while the running image has not been confirmed yet
+bool ota_on_trial();
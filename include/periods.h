@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Runtime-configurable task periods with a static load model.
+//
+// Each periodic job has an estimated CPU cost per run and a number of I2C
+// bytes/transactions per run. For a set of periods the model sums
+// cost / period per core and the bus time per second at the I2C clock. A
+// change that would push the bus over LOAD_I2C_MAX_PERMILLE or a core over
+// LOAD_CPU_MAX_PERMILLE is refused, so the display and sensor keep their
+// rates when several zones share a bus. Periods are kept in NVS.
+
+enum PeriodId {
+  PERIOD_SENSOR,
+  PERIOD_LEVEL,
+  PERIOD_CONTROL,
+  PERIOD_DISPLAY,
+  PERIOD_COUNT,
+};
+
+#define PERIOD_DEFAULTS {2000, 1000, 1000, 1000}
+#define PERIOD_MIN_MS {HumiditySensor::MIN_PERIOD_MS, 50, 100, 100}   // Sensor limit from its driver
+#define PERIOD_MAX_MS 60000
+
+#define LOAD_I2C_MAX_PERMILLE 700   // Headroom for retries and clock stretching
+#define LOAD_CPU_MAX_PERMILLE 800
+#define LOAD_I2C_TXN_BITS 20        // Start, address, stop and ACK gaps per transaction
+
+// Worst-case cost of one run of a job
+struct JobCost {
+  const char *name;
+  uint8_t core;
+  uint16_t cpuUs;
+  uint16_t i2cBytes;
+  uint8_t i2cTransactions;
+};
+
+struct LoadEstimate {
+  uint16_t cpuPermille[2];   // Per core
+  uint16_t i2cPermille;
+};
+
+// Costs for the current build (panel type, I2C write size), see periods.cpp
+extern const JobCost jobCosts[PERIOD_COUNT];
+
+// Pure function of the cost table, the periods (ms) and the I2C clock
+void load_estimate(const JobCost *jobs, const uint32_t *periods, uint32_t i2cHz, LoadEstimate *out);
+
+// i2cHz: bus clock from hal_i2c_begin()
+void periods_begin(uint32_t i2cHz);
+
+uint32_t period_ms(PeriodId id);
+
+// Returns false (and leaves the periods unchanged) if ms is out of range or
+// the resulting load is over budget
+bool period_set(PeriodId id, uint32_t ms);
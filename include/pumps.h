@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pump channels with wear leveling.
+//
+// Each channel tracks its runtime and start count (kept in NVS). When a cycle
+// starts, the channel with the least wear leads and the others are lag pumps
+// that only run alongside it when one pump cannot meet demand. The lead only
+// changes once another channel is ahead by PUMP_ROTATE_MARGIN_S, so similar
+// pumps do not swap every cycle.
+
+#ifndef PUMP_CHANNELS
+#define PUMP_CHANNELS 1           // Number of fitted pumps, up to PUMP_MAX_CHANNELS
+#endif
+#define PUMP_MAX_CHANNELS 3
+#define PUMP_PINS {25, 27, 32}
+#define PUMP_PWM_CHANNELS {0, 1, 2}
+
+// PWM configuration for motor control
+#define PWM_FREQ 1000      // 1 kHz (suitable for motor control)
+#define PWM_RESOLUTION 8   // 8-bit resolution (0-255)
+#define PWM_DUTY_85 217    // 85% of 255
+
+#define PUMP_START_WEAR_S 30       // Wear of one start, counted as seconds of runtime
+#define PUMP_ROTATE_MARGIN_S 600   // Wear lead needed before the lead pump changes
+#define PUMP_SAVE_PERIOD_MS 600000 // Counters are written to NVS at most this often
+
+struct PumpWear {
+  uint32_t runtimeS;
+  uint32_t starts;
+};
+
+void pumps_begin();
+
+// Starts `count` pumps, lead first; running pumps stay on
+void pumps_start(int count);
+void pumps_stop_all();
+int pumps_running();
+
+// Pumps needed for a humidity deficit (%RH below preset): one, plus one more
+// for every lagDeficit (scheduled, see gains.h), capped at PUMP_CHANNELS
+int pumps_needed(float deficit, float lagDeficit);
+
+uint32_t pumps_total_runtime();
+uint32_t pumps_total_starts();
+void pumps_get_wear(int channel, PumpWear *out);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// Safety supervisor, independent of the controller state machine.
+//
+// A small high-priority task on core 1 (the sensor, level and control tasks
+// run on core 0) samples the real outputs every SAFETY_PERIOD_MS: the valve
+// pin read back through its input buffer, the pump PWM duty registers, and
+// the raw float input. It checks three interlocks:
+//   - no pump runs while the float has reported empty for longer than the
+//     controller needs to react (its debounce plus one control period)
+//   - pump and valve are never on together
+//   - the valve is never open longer than the fill time plus two control
+//     periods (the controller closes it on the tick after its countdown)
+// A violation seen on SAFETY_CONFIRM consecutive samples forces all outputs
+// off and latches a fault. While latched the outputs are forced off on every
+// sample and the controller stays idle, until `safety clear`.
+
+#define SAFETY_PERIOD_MS 10
+#define SAFETY_CORE 1
+#define SAFETY_PRIORITY 10         // Above every application task
+#define SAFETY_STACK 2048
+#define SAFETY_CONFIRM 2           // Samples; the controller switches pump and valve in two writes
+#define SAFETY_DRY_MARGIN_MS 5000  // On top of the controller's own reaction to an empty tank
+#define SAFETY_VALVE_MARGIN_MS 30000  // On top of the longest refill the controller can run
+
+enum SafetyFault : uint8_t {
+  SAFETY_OK = 0,
+  SAFETY_DRY_RUN = 1,          // Pump running on an empty tank
+  SAFETY_PUMP_AND_VALVE = 2,
+  SAFETY_VALVE_TIMEOUT = 3,
+};
+
+struct SafetyStats {
+  uint32_t samples;
+  uint32_t maxGapUs;       // Longest time between two samples
+  uint32_t maxCheckUs;     // Longest single check, including forcing outputs
+  uint32_t trips;
+  // Worst measured reaction: from the last clean sample before a violation
+  // to the outputs being off. The violation may have begun right after that
+  // sample, so this bounds the real reaction time for that trip.
+  uint32_t maxReactionUs;
+  uint32_t lastReactionUs; // The same for the most recent trip
+  uint32_t testReactionUs; // From injecting a violation (`safety test`) to outputs off
+};
+
+// Starts the supervisor task and registers the `safety` console command.
+// Call after controller_begin(), once the outputs are configured.
+void safety_begin();
+
+// One supervisor sample; the task calls this every SAFETY_PERIOD_MS
+void safety_check(int64_t nowUs);
+
+// True while a real fault is latched; a `safety test` trip does not count
+bool safety_latched();
+// True while any latch holds the outputs off, a `safety test` trip included
+bool safety_outputs_held();
+SafetyFault safety_fault();
+const char *safety_fault_name(SafetyFault f);
+void safety_get_stats(SafetyStats *out);
+
+// Releases the latch. The outputs stay off until the controller starts them.
+void safety_clear();
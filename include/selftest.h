@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// Boot self-test. Every check runs in its own task so slow peripherals (the
+// DHT20 needs ~80 ms per measurement) overlap instead of adding up. Whatever
+// has not finished when the budget runs out is reported as TIMEOUT. Results
+// go to the console and to the history event log (EVENT_SELFTEST).
+
+#define SELFTEST_BUDGET_MS 500
+#define SELFTEST_MAX 8
+#define SELFTEST_STACK 3072
+
+#ifndef SELFTEST_PULSE_OUTPUTS
+#define SELFTEST_PULSE_OUTPUTS 0   // 1 = briefly pulse the valve during the test
+#endif
+
+enum SelfTestResult : int16_t {
+  SELFTEST_PASS = 0,
+  SELFTEST_FAIL = 1,
+  SELFTEST_TIMEOUT = 2,
+  SELFTEST_SKIP = 3,
+};
+
+// A check returns its result and may put a code (status byte, error, ...) in *detail
+typedef SelfTestResult (*SelfTestFn)(int32_t *detail);
+
+struct SelfTest {
+  const char *name;
+  SelfTestFn fn;
+};
+
+struct SelfTestReport {
+  SelfTestResult result;
+  int32_t detail;
+  uint32_t ms;   // Time the check took, or the budget for TIMEOUT
+};
+
+// Runs all checks concurrently and waits at most budgetMs for their results.
+// Returns true when nothing failed or timed out, but only once every check
+// task has ended, so no late check touches a peripheral after the caller
+// moves on.
+bool selftest_run(const SelfTest *tests, int n, uint32_t budgetMs);
+
+bool selftest_passed();
+const char *selftest_result_name(SelfTestResult r);
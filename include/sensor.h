@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+// Humidity/temperature sensor driver interface. The driver is picked at
+// compile time (sensor_drivers.h) and used through its concrete type, so
+// reads are direct calls with no virtual dispatch. A driver provides:
+//
+//   bool begin();                  Probe and configure, start periodic mode
+//   bool isConnected();
+//   int check();                   Quick health check without a measurement
+//   int read();                    SENSOR_OK or an error below
+//   float getTemperature() const;  C, from the last good read
+//   float getHumidity() const;     %RH, from the last good read
+//   static const char *name();
+//   static constexpr bool PERIODIC;              Sensor measures on its own
+//   static constexpr uint32_t MIN_PERIOD_MS;     Shortest useful read period
+//   static constexpr uint16_t I2C_BYTES;         Bus bytes per read()
+//   static constexpr uint8_t I2C_TRANSACTIONS;   Bus transactions per read()
+
+#define SENSOR_OK 0
+#define SENSOR_ERROR_CHECKSUM -10
+#define SENSOR_ERROR_CONNECT -11
+#define SENSOR_MISSING_BYTES -12
+#define SENSOR_ERROR_BYTES_ALL_ZERO -13
+#define SENSOR_ERROR_READ_TIMEOUT -14
+#define SENSOR_NO_DATA -15       // Periodic mode: no new sample since the last fetch
+#define SENSOR_ERROR_STATUS -16  // Status register reports a fault or missing calibration
+
+// Compile-time interface check, usable with C++11 (Arduino core) and C++20
+template <typename T>
+struct IsHumiditySensor {
+  template <typename U>
+  static auto test(int) -> decltype(
+      static_cast<bool>(std::declval<U &>().begin()), static_cast<bool>(std::declval<U &>().isConnected()),
+      static_cast<int>(std::declval<U &>().check()), static_cast<int>(std::declval<U &>().read()),
+      static_cast<float>(std::declval<const U &>().getTemperature()),
+      static_cast<float>(std::declval<const U &>().getHumidity()), static_cast<const char *>(U::name()),
+      static_cast<bool>(U::PERIODIC), static_cast<uint32_t>(U::MIN_PERIOD_MS), static_cast<uint16_t>(U::I2C_BYTES),
+      static_cast<uint8_t>(U::I2C_TRANSACTIONS), std::true_type());
+  template <typename>
+  static std::false_type test(...);
+  static constexpr bool value = decltype(test<T>(0))::value;
+};
+
+#if defined(__cpp_concepts)
+template <typename T>
+concept HumiditySensorDriver = IsHumiditySensor<T>::value;
+#endif
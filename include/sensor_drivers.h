@@ -0,0 +1,161 @@
+#pragma once
+
+#include "sensor.h"
+#include "hal.h"
+
+// Sensor backends. Pick one with the HUMIDITY_SENSOR build flag.
+//   SENSOR_DHT20  Aosong DHT20/AHT20 at 0x38, triggered, ~80 ms per measurement (default)
+//   SENSOR_SHT3X  Sensirion SHT30/31/35 at 0x44; periodic acquisition at SHT3X_MPS
+//                 measurements per second, a read is one short fetch.
+//                 SHT3X_MPS=0 selects single-shot (~15 ms per read)
+//   SENSOR_SHT4X  Sensirion SHT40/41/45 at 0x44, single-shot high precision (~9 ms)
+
+#define SENSOR_DHT20 1
+#define SENSOR_SHT3X 2
+#define SENSOR_SHT4X 3
+
+#ifndef HUMIDITY_SENSOR
+#define HUMIDITY_SENSOR SENSOR_DHT20
+#endif
+
+#ifndef SHT3X_MPS
+#define SHT3X_MPS 1   // 0 (single shot), 1, 2, 4 or 10
+#endif
+
+#define DHT20_ADDR 0x38
+#ifndef SHT3X_ADDR
+#define SHT3X_ADDR 0x44   // 0x45 with ADDR pulled high
+#endif
+#define SHT4X_ADDR 0x44
+
+class DHT20 {
+ public:
+  static constexpr bool PERIODIC = false;
+  static constexpr uint32_t MIN_PERIOD_MS = 1000;   // Self-heating above 1 Hz
+  static constexpr uint16_t I2C_BYTES = 10;         // Trigger write + 7-byte read
+  static constexpr uint8_t I2C_TRANSACTIONS = 2;
+  static const char *name() { return "DHT20"; }
+
+  bool begin();
+  bool isConnected();
+  int check();
+  uint8_t readStatus();
+
+  // Blocking single-shot measurement (~80 ms)
+  int read();
+  float getTemperature() const { return temperature; }
+  float getHumidity() const { return humidity; }
+
+ private:
+  float temperature = 0.0;
+  float humidity = 0.0;
+};
+
+// Command, CRC and conversion shared by both SHT3x modes
+class Sht3xBase {
+ public:
+  bool isConnected();
+  int check();   // Sensor must be idle (not in periodic acquisition)
+  float getTemperature() const { return temperature; }
+  float getHumidity() const { return humidity; }
+
+ protected:
+  bool command(uint16_t cmd);
+  int fetch();   // Reads and converts one 6-byte sample
+
+  float temperature = 0.0;
+  float humidity = 0.0;
+};
+
+// Mps = measurements per second in periodic mode, 0 for single shot
+template <uint8_t Mps>
+class Sht3x : public Sht3xBase {
+  static_assert(Mps == 0 || Mps == 1 || Mps == 2 || Mps == 4 || Mps == 10, "SHT3x supports 1, 2, 4 or 10 mps");
+
+  // High repeatability periodic commands (datasheet table 10)
+  static constexpr uint16_t periodicCommand() {
+    return Mps == 1 ? 0x2130 : Mps == 2 ? 0x2236 : Mps == 4 ? 0x2334 : 0x2737;
+  }
+
+ public:
+  static constexpr bool PERIODIC = Mps != 0;
+  // Reading faster than the sensor measures only returns SENSOR_NO_DATA
+  static constexpr uint32_t MIN_PERIOD_MS = PERIODIC ? 1000 / (Mps ? Mps : 1) + 50 : 100;
+  static constexpr uint16_t I2C_BYTES = 8;   // 2-byte command + 6-byte sample
+  static constexpr uint8_t I2C_TRANSACTIONS = 2;
+  static const char *name() { return PERIODIC ? "SHT3x periodic" : "SHT3x"; }
+
+  bool begin() {
+    if (!isConnected()) {
+      return false;
+    }
+    command(0x30A2);   // Soft reset, also stops a periodic mode left running
+    hal_delay_ms(2);
+    return PERIODIC ? command(periodicCommand()) : true;
+  }
+
+  // In periodic mode the sensor only takes Fetch, ART, Break and soft reset,
+  // so stop acquisition for the status read and start it again
+  int check() {
+    if (!PERIODIC) {
+      return Sht3xBase::check();
+    }
+    if (!command(0x3093)) {   // Break
+      return SENSOR_ERROR_CONNECT;
+    }
+    hal_delay_ms(1);
+    int err = Sht3xBase::check();
+    if (!command(periodicCommand())) {
+      return SENSOR_ERROR_CONNECT;
+    }
+    return err;
+  }
+
+  int read() {
+    if (PERIODIC) {
+      // Fetch Data; the sensor NACKs the read when no new sample is ready
+      if (!command(0xE000)) {
+        return SENSOR_ERROR_CONNECT;
+      }
+      int err = fetch();
+      return err == SENSOR_MISSING_BYTES ? SENSOR_NO_DATA : err;
+    }
+    if (!command(0x2400)) {   // Single shot, high repeatability, no clock stretching
+      return SENSOR_ERROR_CONNECT;
+    }
+    hal_delay_ms(16);
+    return fetch();
+  }
+};
+
+class Sht4x {
+ public:
+  static constexpr bool PERIODIC = false;
+  static constexpr uint32_t MIN_PERIOD_MS = 100;
+  static constexpr uint16_t I2C_BYTES = 7;   // 1-byte command + 6-byte sample
+  static constexpr uint8_t I2C_TRANSACTIONS = 2;
+  static const char *name() { return "SHT4x"; }
+
+  bool begin();
+  bool isConnected();
+  int check();
+
+  // Blocking high-precision measurement (~9 ms)
+  int read();
+  float getTemperature() const { return temperature; }
+  float getHumidity() const { return humidity; }
+
+ private:
+  float temperature = 0.0;
+  float humidity = 0.0;
+};
+
+#if HUMIDITY_SENSOR == SENSOR_SHT3X
+typedef Sht3x<SHT3X_MPS> HumiditySensor;
+#elif HUMIDITY_SENSOR == SENSOR_SHT4X
+typedef Sht4x HumiditySensor;
+#else
+typedef DHT20 HumiditySensor;
+#endif
+
+static_assert(IsHumiditySensor<HumiditySensor>::value, "HumiditySensor does not implement the sensor.h interface");
@@ -0,0 +1,94 @@
+#include "controller.h"
+#include "controller_api.h"
+#include "hal.h"
+#include "hal_host.h"
+#include "host_stubs.h"
+#include "kpi.h"
+#include "periods.h"
+#include "pumps.h"
+#include "safety.h"
+
+static const uint32_t periodDefaults[PERIOD_COUNT] = PERIOD_DEFAULTS;
+static const int pumpPwm[PUMP_MAX_CHANNELS] = PUMP_PWM_CHANNELS;
+
+static void api_begin() {
+  hal_host_set_ms(0);
+  coord_host_set(false);
+  for (int id = 0; id < PERIOD_COUNT; id++) {
+    host_period_set((PeriodId)id, periodDefaults[id]);
+  }
+  controller_begin();
+}
+
+static void api_set_period(int period, uint32_t ms) {
+  host_period_set((PeriodId)period, ms);
+}
+
+static void api_reading(float temperatureC, float rh) {
+  controller_reading(temperatureC, rh - HUMIDITY_OFFSET);
+}
+
+static void api_set_float(int level) {
+  hal_gpio_write(WATER_LEVEL_PIN, level);
+}
+
+static void api_sample_level() {
+  controller_level(hal_gpio_read(WATER_LEVEL_PIN));
+}
+
+static void api_tick(int seconds) {
+  controller_tick(seconds);
+}
+
+static void api_supervise(int64_t nowUs) {
+  safety_check(nowUs);
+}
+
+static int api_pumps_running() {
+  int pumps = 0;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    pumps += hal_pwm_read(pumpPwm[ch]) != 0;
+  }
+  return pumps;
+}
+
+static bool api_valve_open() {
+  return hal_gpio_read(VALVE_PIN) == HIGH;
+}
+
+static void api_status(SimControllerStatus *out) {
+  out->humidity = humidity;
+  out->pumpState = pumpState;
+  out->countdown = countdown;
+  out->pumpStarts = pumps_total_starts();
+  out->controlRecords = hostCounters.controlRecords;
+  out->safetyEvents = hostCounters.safetyEvents;
+}
+
+static const SimController controller = {
+    SIM_CONTROLLER_ABI,
+    __DATE__ " " __TIME__,
+    HUMIDITY_PRESET,
+    KPI_BAND / 10.0f,
+    periodDefaults[PERIOD_SENSOR],
+    periodDefaults[PERIOD_LEVEL],
+    periodDefaults[PERIOD_CONTROL],
+    api_begin,
+    hal_host_set_ms,
+    api_reading,
+    api_set_float,
+    api_sample_level,
+    api_tick,
+    api_supervise,
+    api_pumps_running,
+    api_valve_open,
+    api_status,
+    hal_host_set_verbose,
+    coord_host_set,
+    api_set_period,
+};
+
+// The only symbol libcontroller_sim.so exports (it builds with hidden visibility)
+extern "C" __attribute__((visibility("default"))) const SimController *sim_controller() {
+  return &controller;
+}
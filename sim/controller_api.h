@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+// What the simulator needs from a controller build. controller_api.cpp
+// implements it over the firmware modules. house_sim links that statically.
+// libcontroller_sim.so exports it as sim_controller(), so sim_server can
+// run builds it was not compiled with. A build whose abi differs from
+// SIM_CONTROLLER_ABI is refused.
+//
+// An instance keeps its state in the firmware's globals: one house at a
+// time, and a fresh process or a fresh dlopen() for the next one.
+
+#define SIM_CONTROLLER_ABI 3
+#define SIM_CONTROLLER_SYMBOL "sim_controller"
+
+// Task periods a scenario can change, in PeriodId order
+enum SimPeriod { SIM_PERIOD_SENSOR, SIM_PERIOD_LEVEL, SIM_PERIOD_CONTROL, SIM_PERIODS };
+
+struct SimControllerStatus {
+  float humidity;         // As the controller sees it, after HUMIDITY_OFFSET
+  int pumpState;          // PumpState
+  int countdown;
+  uint32_t pumpStarts;
+  uint32_t controlRecords;
+  uint32_t safetyEvents;
+};
+
+struct SimController {
+  uint32_t abi;
+  const char *build;            // Compiler date and time of the build
+  float targetRh;               // HUMIDITY_PRESET
+  float bandRh;                 // KPI_BAND, +- %RH
+  uint32_t sensorPeriodMs;      // Default task periods
+  uint32_t levelPeriodMs;
+  uint32_t controlPeriodMs;
+
+  void (*begin)();              // Clock at 0, then controller_begin()
+  void (*set_ms)(uint32_t ms);
+  void (*reading)(float temperatureC, float rh);   // True RH; the build applies its offset
+  void (*set_float)(int level);                    // Drives the float input, HIGH = empty
+  void (*sample_level)();                          // One level task run
+  void (*tick)(int seconds);                       // One control task run
+  void (*supervise)(int64_t nowUs);                // One safety supervisor sample
+  int (*pumps_running)();                          // From the PWM outputs
+  bool (*valve_open)();                            // From the valve pin
+  void (*status)(SimControllerStatus *out);
+  void (*set_verbose)(bool on);                    // Firmware log lines to stdout
+  void (*set_coordinated)(bool on);                // Duty from a coordinator (coord_host.cpp)
+  void (*set_period)(int period, uint32_t ms);     // SimPeriod, as period_ms() then returns it
+};
+
+typedef const SimController *(*SimControllerEntry)();
+
+extern "C" const SimController *sim_controller();
@@ -0,0 +1,80 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "controller_lib.h"
+
+// Copies src into a new temporary file; returns its fd with the name in tmp
+static int copy_to_temp(const char *src, char *tmp, size_t tmpLen) {
+  const char *dir = getenv("TMPDIR");
+  snprintf(tmp, tmpLen, "%s/controller-XXXXXX.so", dir != NULL && dir[0] != '\0' ? dir : "/tmp");
+  int in = open(src, O_RDONLY);
+  if (in < 0) {
+    return -1;
+  }
+  int out = mkstemps(tmp, 3);
+  if (out < 0) {
+    close(in);
+    return -1;
+  }
+  char buf[65536];
+  ssize_t n;
+  while ((n = read(in, buf, sizeof(buf))) > 0) {
+    if (write(out, buf, n) != n) {
+      n = -1;
+      break;
+    }
+  }
+  close(in);
+  if (n < 0) {
+    close(out);
+    unlink(tmp);
+    return -1;
+  }
+  return out;
+}
+
+bool controller_lib_open(const char *path, ControllerLib *out, char *err, size_t errLen) {
+  out->handle = NULL;
+  out->api = NULL;
+  char tmp[256];
+  int fd = copy_to_temp(path, tmp, sizeof(tmp));
+  if (fd < 0) {
+    snprintf(err, errLen, "%s: %s", path, strerror(errno));
+    return false;
+  }
+  close(fd);
+  void *handle = dlopen(tmp, RTLD_NOW | RTLD_LOCAL);
+  unlink(tmp);
+  if (handle == NULL) {
+    snprintf(err, errLen, "%s: %s", path, dlerror());
+    return false;
+  }
+  SimControllerEntry entry = (SimControllerEntry)dlsym(handle, SIM_CONTROLLER_SYMBOL);
+  const SimController *api = entry != NULL ? entry() : NULL;
+  if (api == NULL) {
+    snprintf(err, errLen, "%s: no %s()", path, SIM_CONTROLLER_SYMBOL);
+    dlclose(handle);
+    return false;
+  }
+  if (api->abi != SIM_CONTROLLER_ABI) {
+    snprintf(err, errLen, "%s: controller ABI %u, this server runs %u", path, (unsigned)api->abi,
+             SIM_CONTROLLER_ABI);
+    dlclose(handle);
+    return false;
+  }
+  out->handle = handle;
+  out->api = api;
+  return true;
+}
+
+void controller_lib_close(ControllerLib *lib) {
+  if (lib->handle != NULL) {
+    dlclose(lib->handle);
+  }
+  lib->handle = NULL;
+  lib->api = NULL;
+}
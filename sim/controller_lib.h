@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include "controller_api.h"
+
+// Loads a controller build (libcontroller_sim.so) for one house run.
+//
+// The firmware keeps its state in globals, and dlopen() hands out the same
+// instance for the same file. So every load copies the library to a private
+// temporary file first and opens that copy. Each run then starts from fresh
+// globals, and runs on different threads share nothing. The copy is unlinked
+// as soon as it is mapped.
+
+struct ControllerLib {
+  void *handle;
+  const SimController *api;
+};
+
+// Returns false with the reason in err if the file cannot be loaded, has no
+// sim_controller() or was built for another SIM_CONTROLLER_ABI
+bool controller_lib_open(const char *path, ControllerLib *out, char *err, size_t errLen);
+void controller_lib_close(ControllerLib *lib);
@@ -0,0 +1,36 @@
+#include <math.h>
+#include "controller.h"
+#include "coord.h"
+#include "gains.h"
+#include "host_stubs.h"
+
+// The RS-485 coordinator as the controller sees it. Off, the unit runs on its
+// own sensor. On, the unit is the only member of a group: its duty and the
+// target decision come from coord_assign() over its own status, as the master
+// would send them. They are worked out on every control tick rather than every
+// COORD_PERIOD_MS.
+
+static bool coordinated = false;
+static uint8_t duty = 0;
+static bool atTarget = false;
+
+void coord_host_set(bool on) {
+  coordinated = on;
+  duty = 0;
+  atTarget = false;
+}
+
+void coord_set_local(const CoordStatus *status) {
+  CoordUnit unit = {true, 0, *status};
+  GainSet gains;
+  gains_current(&gains);
+  atTarget = coord_assign(&unit, 1, (int16_t)lroundf(HUMIDITY_PRESET * 10), gains.hysteresis, atTarget, &duty);
+}
+
+int coord_pump_duty() {
+  return coordinated ? duty : -1;
+}
+
+bool coord_at_target() {
+  return atTarget;
+}
@@ -0,0 +1,248 @@
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include "coord.h"
+#include "hal.h"
+#include "hal_host.h"
+
+// Host checks for the RS-485 coordination: coord_assign() on its own, then a
+// master and two slaves running the real coord.cpp over pty pairs. Each unit
+// keeps its state in coord.cpp's globals, so every slave is a forked process.
+// The master's writes reach every slave and each slave's replies reach the
+// master, which is all the protocol relies on from the shared bus.
+//
+//   cmake --build sim/build --target coord_test && sim/build/coord_test
+
+#define PRESET 500   // 50.0 %RH
+
+struct SlaveReport {
+  int id;
+  int duty;          // Last assigned duty, -1 if never polled
+  bool atTarget;
+  bool fallback;     // Standalone again once the master went quiet
+};
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("FAIL %s\n", what);
+  }
+}
+
+static void check_duties(const char *what, const uint8_t *got, const uint8_t *want, int n) {
+  bool same = memcmp(got, want, n) == 0;
+  check(same, what);
+  if (!same) {
+    printf("  got ");
+    for (int i = 0; i < n; i++) {
+      printf(" %3u", got[i]);
+    }
+    printf("\n  want");
+    for (int i = 0; i < n; i++) {
+      printf(" %3u", want[i]);
+    }
+    printf("\n");
+  }
+}
+
+static CoordUnit unit(int16_t humidity, uint32_t runtimeMin, bool waterEmpty = false, bool filling = false) {
+  CoordUnit u = {true, 0, {humidity, waterEmpty, filling, runtimeMin}};
+  return u;
+}
+
+static void assign_checks() {
+  uint8_t duty[COORD_MAX_UNITS];
+
+  // 2 %RH short: 100 % of one unit, split evenly at equal runtime
+  CoordUnit even[] = {unit(480, 600), unit(480, 600)};
+  const uint8_t evenWant[] = {50, 50};
+  check(!coord_assign(even, 2, PRESET, 0, false, duty), "deficit: not at target");
+  check_duties("deficit split evenly", duty, evenWant, 2);
+
+  // The unit with 20 h less runtime weighs 1800 against 600
+  CoordUnit worn[] = {unit(480, 0), unit(480, 1200)};
+  const uint8_t wornWant[] = {75, 25};
+  coord_assign(worn, 2, PRESET, 0, false, duty);
+  check_duties("runtime weighting", duty, wornWant, 2);
+
+  // 150 % to share: the fresh unit caps at 100, the rest goes to the other
+  CoordUnit big[] = {unit(470, 0), unit(470, 1200)};
+  const uint8_t bigWant[] = {100, 50};
+  coord_assign(big, 2, PRESET, 0, false, duty);
+  check_duties("cap at 100 %, overflow to the rest", duty, bigWant, 2);
+
+  // Empty and filling units count towards the average but get no duty;
+  // an offline unit counts for nothing
+  CoordUnit mixed[] = {unit(480, 600), unit(480, 600, true), unit(480, 600, false, true), unit(100, 600)};
+  mixed[3].online = false;
+  const uint8_t mixedWant[] = {100, 0, 0, 0};
+  check(!coord_assign(mixed, 4, PRESET, 0, false, duty), "empty/filling: house still short");
+  check_duties("empty and filling units get no duty", duty, mixedWant, 4);
+
+  CoordUnit full[] = {unit(505, 600), unit(495, 600)};
+  const uint8_t zero[] = {0, 0};
+  check(coord_assign(full, 2, PRESET, 0, false, duty), "average at preset: at target");
+  check_duties("at target: no duty", duty, zero, 2);
+
+  CoordUnit blind[] = {unit(0, 600), unit(0, 600)};
+  check(coord_assign(blind, 2, PRESET, 0, false, duty), "no readings: hold");
+  check_duties("no readings: no duty", duty, zero, 2);
+
+  // Hysteresis of 1 %RH: once reached, the target holds until the average is
+  // that far below the preset
+  CoordUnit near[] = {unit(496, 600), unit(496, 600)};
+  check(coord_assign(near, 2, PRESET, 10, true, duty), "hysteresis: held 0.4 %RH below the preset");
+  check_duties("hysteresis: no duty while held", duty, zero, 2);
+  check(!coord_assign(near, 2, PRESET, 10, false, duty), "hysteresis: not at target on the way up");
+  CoordUnit low[] = {unit(490, 600), unit(490, 600)};
+  check(!coord_assign(low, 2, PRESET, 10, true, duty), "hysteresis: released 1 %RH below the preset");
+
+  // A house average wobbling around the preset flips a bare deficit check
+  // every round; with the hysteresis it settles at target
+  int flips[2] = {0, 0};
+  for (int h = 0; h < 2; h++) {
+    bool atTarget = false;
+    for (int round = 0; round < 100; round++) {
+      CoordUnit wobble[] = {unit(round % 2 ? 502 : 497, 600)};
+      bool now = coord_assign(wobble, 1, PRESET, h ? 10 : 0, atTarget, duty);
+      flips[h] += now != atTarget;
+      atTarget = now;
+    }
+  }
+  check(flips[0] > 90, "no hysteresis: the decision follows the noise");
+  check(flips[1] == 1, "hysteresis: noise around the preset does not restart the pumps");
+}
+
+// Slave side, in the forked child: answer polls until the master hangs up
+static void run_slave(int id, int fd, CoordStatus status, int reportFd) {
+  hal_host_set_ms(1000);
+  hal_host_uart_link(COORD_UART, &fd, 1);
+  coord_begin(id, PRESET);
+  coord_set_local(&status);
+  SlaveReport r = {id, -1, false, false};
+  while (hal_host_uart_linked(COORD_UART)) {
+    coord_slave_poll();
+    if (coord_pump_duty() >= 0) {
+      r.duty = coord_pump_duty();
+      r.atTarget = coord_at_target();
+    }
+  }
+  hal_host_set_ms(hal_millis() + COORD_TIMEOUT_MS + 1);
+  r.fallback = coord_pump_duty() == -1;
+  if (write(reportFd, &r, sizeof(r)) != sizeof(r)) {
+    _exit(1);
+  }
+  _exit(0);
+}
+
+// `others` are the master's ends of the links already made, which the child
+// must not hold open: the master hangs up on a slave by closing its end
+static bool spawn_slave(int id, CoordStatus status, int reportFd, const int *others, int otherCount, int *masterFd,
+                        pid_t *pid) {
+  int slaveFd;
+  if (openpty(masterFd, &slaveFd, NULL, NULL, NULL) < 0) {
+    perror("openpty");
+    return false;
+  }
+  struct termios raw;
+  tcgetattr(slaveFd, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(slaveFd, TCSANOW, &raw);
+  *pid = fork();
+  if (*pid == 0) {
+    close(*masterFd);
+    for (int i = 0; i < otherCount; i++) {
+      close(others[i]);
+    }
+    run_slave(id, slaveFd, status, reportFd);
+  }
+  close(slaveFd);
+  return *pid > 0;
+}
+
+static void bus_checks() {
+  // Unit 3's tank is empty: it gets no duty, but must not be told the house
+  // is at the preset, or it would never open its valve
+  CoordStatus status[] = {{470, 0, 0, 600}, {490, 0, 0, 600}, {460, 1, 0, 600}};
+  CoordUnit want[COORD_MAX_UNITS] = {{true, 0, status[0]}, {true, 0, status[1]}, {true, 0, status[2]}};
+  uint8_t wantDuty[COORD_MAX_UNITS];
+  coord_assign(want, COORD_MAX_UNITS, PRESET, 0, false, wantDuty);
+
+  int reports[2];
+  if (pipe(reports) < 0) {
+    perror("pipe");
+    check(false, "bus: pipe");
+    return;
+  }
+  int fds[2];
+  pid_t pids[2];
+  for (int i = 0; i < 2; i++) {
+    if (!spawn_slave(i + 2, status[i + 1], reports[1], fds, i, &fds[i], &pids[i])) {
+      check(false, "bus: start slave");
+      return;
+    }
+  }
+  close(reports[1]);
+
+  hal_host_set_ms(1000);
+  hal_host_uart_link(COORD_UART, fds, 2);
+  coord_begin(COORD_MASTER_ID, PRESET);
+  coord_set_local(&status[0]);
+  // A poll carries the previous round's assignment; the slaves see it from
+  // the second round on
+  for (int round = 0; round < 3; round++) {
+    coord_master_round();
+  }
+  check(coord_pump_duty() == wantDuty[0], "bus: master's own duty");
+  check(!coord_at_target(), "bus: master not at target");
+
+  // Unit 3 drops off the bus: after COORD_MAX_MISSES missed polls the master
+  // leaves its humidity out of the average
+  int left = fds[0];
+  hal_host_uart_link(COORD_UART, &left, 1);
+  close(fds[1]);
+  CoordUnit after[COORD_MAX_UNITS] = {want[0], want[1]};
+  uint8_t afterDuty[COORD_MAX_UNITS];
+  coord_assign(after, COORD_MAX_UNITS, PRESET, 0, false, afterDuty);
+  for (int round = 0; round < COORD_MAX_MISSES + 3; round++) {
+    coord_master_round();
+  }
+  check(coord_pump_duty() == afterDuty[0], "bus: master's duty once unit 3 is offline");
+  close(fds[0]);
+
+  SlaveReport r;
+  int seen = 0;
+  while (read(reports[0], &r, sizeof(r)) == sizeof(r)) {
+    seen++;
+    if (r.id == 2) {
+      check(r.duty == afterDuty[1], "bus: unit 2 gets the share without unit 3");
+    } else {
+      check(r.duty == wantDuty[2] && r.duty == 0, "bus: empty unit 3 gets no duty");
+    }
+    check(!r.atTarget, "bus: slaves not told the house is at target");
+    check(r.fallback, "bus: slave standalone again after COORD_TIMEOUT_MS");
+  }
+  close(reports[0]);
+  check(seen == 2, "bus: both slaves reported");
+  for (int i = 0; i < 2; i++) {
+    int st;
+    waitpid(pids[i], &st, 0);
+    check(WIFEXITED(st) && WEXITSTATUS(st) == 0, "bus: slave exit status");
+  }
+}
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);   // A write to a closed pty drops the link instead
+  assign_checks();
+  bus_checks();
+  printf("%d of %d coordination checks passed\n", checks - failures, checks);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "hal.h"
+#include "hal_host.h"
+
+static uint32_t nowMs = 0;
+static bool verbose = false;
+static int gpioLevel[HAL_HOST_PINS];
+static uint32_t pwmDuty[HAL_HOST_PWM_CHANNELS];
+
+struct UartLinks {
+  int fds[HAL_HOST_UART_LINKS];
+  int count;
+};
+
+static UartLinks uarts[HAL_HOST_UARTS];
+
+void hal_host_set_ms(uint32_t ms) {
+  nowMs = ms;
+}
+
+void hal_host_set_verbose(bool on) {
+  verbose = on;
+}
+
+void hal_host_uart_link(int port, const int *fds, int count) {
+  UartLinks &u = uarts[port];
+  u.count = count < HAL_HOST_UART_LINKS ? count : HAL_HOST_UART_LINKS;
+  for (int i = 0; i < u.count; i++) {
+    u.fds[i] = fds[i];
+  }
+}
+
+bool hal_host_uart_linked(int port) {
+  return port >= 0 && port < HAL_HOST_UARTS && uarts[port].count > 0;
+}
+
+static void uart_drop(UartLinks *u, int i) {
+  u->fds[i] = u->fds[--u->count];
+}
+
+
+// Console: firmware log lines go to stdout with --verbose
+void hal_console_begin(uint32_t baud) {}
+
+void hal_console_write(const void *data, size_t len) {
+  if (verbose) {
+    fwrite(data, 1, len, stdout);
+  }
+}
+
+size_t hal_console_read(uint8_t *data, size_t maxLen, uint32_t timeoutMs) {
+  return 0;
+}
+
+// Time
+uint32_t hal_millis() {
+  return nowMs;
+}
+
+int64_t hal_micros() {
+  return (int64_t)nowMs * 1000;
+}
+
+void hal_delay_ms(uint32_t ms) {}
+
+// GPIO
+void hal_gpio_input(int pin) {}
+
+void hal_gpio_output(int pin, int level) {
+  hal_gpio_write(pin, level);
+}
+
+void hal_gpio_write(int pin, int level) {
+  if (pin >= 0 && pin < HAL_HOST_PINS) {
+    gpioLevel[pin] = level;
+  }
+}
+
+// Inputs are set by the simulator with hal_gpio_write, outputs read back
+int hal_gpio_read(int pin) {
+  return pin >= 0 && pin < HAL_HOST_PINS ? gpioLevel[pin] : LOW;
+}
+
+// Buses are not modelled, except UARTs given links with hal_host_uart_link();
+// the sensor and level inputs are fed by house_sim.cpp
+bool hal_uart_begin(int port, int txPin, int rxPin, uint32_t baud) {
+  return hal_host_uart_linked(port);
+}
+
+void hal_uart_write(int port, const void *data, size_t len) {
+  if (!hal_host_uart_linked(port)) {
+    return;
+  }
+  UartLinks *u = &uarts[port];
+  for (int i = u->count - 1; i >= 0; i--) {
+    if (write(u->fds[i], data, len) != (ssize_t)len) {
+      uart_drop(u, i);
+    }
+  }
+}
+
+size_t hal_uart_read(int port, uint8_t *data, size_t maxLen, uint32_t timeoutMs) {
+  if (hal_host_uart_linked(port)) {
+    UartLinks *u = &uarts[port];
+    struct pollfd pfd[HAL_HOST_UART_LINKS];
+    for (int i = 0; i < u->count; i++) {
+      pfd[i].fd = u->fds[i];
+      pfd[i].events = POLLIN;
+    }
+    if (poll(pfd, u->count, timeoutMs) > 0) {
+      for (int i = u->count - 1; i >= 0; i--) {
+        if (pfd[i].revents == 0) {
+          continue;
+        }
+        ssize_t n = read(pfd[i].fd, data, maxLen);
+        if (n > 0) {
+          return n;
+        }
+        uart_drop(u, i);   // Hung up (EOF, or EIO on a pty)
+      }
+    }
+  }
+  nowMs += timeoutMs;
+  return 0;
+}
+
+void hal_pwm_init(int pin, int channel, uint32_t freq, int resolutionBits) {
+  hal_pwm_write(channel, 0);
+}
+
+void hal_pwm_write(int channel, uint32_t duty) {
+  if (channel >= 0 && channel < HAL_HOST_PWM_CHANNELS) {
+    pwmDuty[channel] = duty;
+  }
+}
+
+uint32_t hal_pwm_read(int channel) {
+  return channel >= 0 && channel < HAL_HOST_PWM_CHANNELS ? pwmDuty[channel] : 0;
+}
+
+bool hal_i2c_begin(int sda, int scl, uint32_t hz) {
+  return false;
+}
+
+bool hal_i2c_probe(uint8_t addr) {
+  return false;
+}
+
+bool hal_i2c_write(uint8_t addr, const uint8_t *data, size_t len) {
+  return false;
+}
+
+bool hal_i2c_read(uint8_t addr, uint8_t *data, size_t len) {
+  return false;
+}
+
+bool hal_spi_begin(int sckPin, int mosiPin, int csPin, uint32_t hz) {
+  return false;
+}
+
+void hal_spi_write(const void *data, size_t len) {}
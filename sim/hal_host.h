@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host backend for hal.h. Time is the simulation clock, outputs are kept in
+// arrays that hal_gpio_read()/hal_pwm_read() return, as the hardware does.
+
+#define HAL_HOST_PINS 40
+#define HAL_HOST_PWM_CHANNELS 16
+#define HAL_HOST_UARTS 3
+#define HAL_HOST_UART_LINKS 4
+
+void hal_host_set_ms(uint32_t ms);
+void hal_host_set_verbose(bool verbose);
+
+// Connects a UART to file descriptors, such as pty ends. The port acts as a
+// bus: a write goes to every link, a read takes from whichever has data. A
+// link that hangs up is dropped. A read that gets nothing moves the clock on
+// by its timeout, so the firmware's waits end as they do on the device.
+void hal_host_uart_link(int port, const int *fds, int count);
+bool hal_host_uart_linked(int port);   // Any links left
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "console.h"
+#include "hal.h"
+#include "hal_host.h"
+#include "history.h"
+#include "partition_host.h"
+
+// Host check for the history index (src/history.cpp): appends with reboots
+// and ring wraps to a RAM-backed partition, then random history_query()
+// ranges compared with a brute-force scan of the records still stored. A
+// process forked before the first append then boots on the same flash,
+// rebuilds the index as history_begin() does on the device, and must give
+// the same answers. Its log time starts over from the oldest record still
+// stored, so its ranges are shifted to keep the newest record at the same
+// place; ranges relative to now, as the console and display use, match.
+//
+//   cmake --build sim/build --target history_test && sim/build/history_test
+
+#define TEST_SECTORS 64        // 8192 records, so the ring wraps twice
+#define TEST_APPENDS 20000
+#define TEST_QUERIES 3000
+
+struct Logged {
+  uint32_t t;   // Log time the record should get
+  HistoryRecord rec;
+};
+
+static Logged logged[TEST_APPENDS];
+static uint32_t rng;
+static int checks = 0;
+static int failures = 0;
+
+// Only history_export() sends frames, and it is not under test here
+void console_register(const char *name, const char *help, ConsoleHandler fn) {}
+void console_begin_binary() {}
+void console_send_frame(uint8_t type, const void *payload, uint16_t len) {}
+void console_end_binary() {}
+
+static void check(bool ok, const char *what) {
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("FAIL %s\n", what);
+  }
+}
+
+static uint32_t next_random() {
+  rng = rng * 1103515245u + 12345u;
+  return rng >> 8;
+}
+
+// The same log every time: the first run appends it, the rebooted one only
+// needs the log times to check against
+static void generate(bool append) {
+  rng = 1;
+  uint32_t base = 0;
+  uint32_t uptime = 0;
+  for (int i = 0; i < TEST_APPENDS; i++) {
+    if (uptime > 3600 && next_random() % 3000 == 0) {
+      base += uptime + 1;   // Reboot: uptime starts over, log time goes on
+      uptime = 0;
+    }
+    uptime += 1 + next_random() % 60;
+    HistoryRecord rec = {};
+    if (next_random() % 4 != 0) {
+      rec.type = HISTORY_SAMPLE;
+      rec.sample.humidity = next_random() % 1000;
+      rec.sample.temperature = (int16_t)(next_random() % 400) - 100;
+      rec.flags = next_random() % 4;
+    } else {
+      rec.type = HISTORY_CONTROL;
+      rec.control.event = next_random() % 3 != 0 ? CONTROL_PUMP_START : CONTROL_SNAPSHOT;
+    }
+    if (append) {
+      hal_host_set_ms(uptime * 1000);
+      history_append(&rec);
+    }
+    logged[i].t = base + uptime;
+    logged[i].rec = rec;
+  }
+}
+
+static bool stats_equal(const HistoryStats &a, const HistoryStats &b) {
+  return a.samples == b.samples && a.humidityMin == b.humidityMin && a.humidityMax == b.humidityMax &&
+         a.humiditySum == b.humiditySum && a.temperatureMin == b.temperatureMin &&
+         a.temperatureMax == b.temperatureMax && a.temperatureSum == b.temperatureSum &&
+         a.pumpSamples == b.pumpSamples && a.valveSamples == b.valveSamples && a.pumpStarts == b.pumpStarts;
+}
+
+static uint32_t shifted(uint32_t t, uint32_t shift) {
+  return t > shift ? t - shift : 0;
+}
+
+// One query against the brute-force scan of the records still in flash. The
+// index's log time is the expected one minus shift.
+static void check_query(const char *who, uint32_t from, uint32_t to, uint32_t shift, const Logged *live,
+                        uint32_t count) {
+  HistoryStats got, want;
+  history_query(shifted(from, shift), shifted(to, shift), &got);
+  history_stats_clear(&want);
+  for (uint32_t i = 0; i < count; i++) {
+    if (live[i].t >= from && live[i].t <= to) {
+      history_stats_add(&want, live[i].rec);
+    }
+  }
+  bool same = stats_equal(got, want);
+  check(same, who);
+  if (!same) {
+    printf("  %u..%u: %u samples, %u starts; scan %u samples, %u starts\n", (unsigned)from, (unsigned)to,
+           got.samples, got.pumpStarts, want.samples, want.pumpStarts);
+  }
+}
+
+static void check_queries(const char *who, uint32_t shift) {
+  uint32_t count = history_count();
+  const Logged *live = logged + TEST_APPENDS - count;
+  uint32_t first = live[0].t;
+  uint32_t last = live[count - 1].t;
+  rng = 7;
+  check_query(who, 0, UINT32_MAX, shift, live, count);
+  check_query(who, last, last, shift, live, count);
+  check_query(who, last > 86400 ? last - 86400 : 0, last, shift, live, count);
+  for (int q = 0; q < TEST_QUERIES; q++) {
+    uint32_t from = q % 7 == 0 ? 0 : first + next_random() % (last - first + 100);
+    uint32_t to = from + next_random() % 200000;
+    check_query(who, from, to, shift, live, count);
+  }
+}
+
+// The rebooted unit: waits for the first run's record count, then boots on
+// the flash it left behind
+static int run_rebooted(int countFd) {
+  uint32_t count;
+  if (read(countFd, &count, sizeof(count)) != sizeof(count)) {
+    return 1;
+  }
+  hal_host_set_ms(0);
+  check(history_begin(), "reboot: history_begin");
+  check(history_count() == count, "reboot: record count");
+  generate(false);
+  // At uptime 0 the clock reads one second after the newest record
+  uint32_t shift = logged[TEST_APPENDS - 1].t - (history_now() - 1);
+  check_queries("reboot: query matches scan", shift);
+  printf("%d of %d history checks passed after the reboot\n", checks - failures, checks);
+  fflush(stdout);
+  return failures == 0 ? 0 : 1;
+}
+
+int main() {
+  size_t size = TEST_SECTORS * HISTORY_SECTOR_SIZE;
+  uint8_t *flash = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  int go[2];
+  if (flash == MAP_FAILED || pipe(go) < 0) {
+    perror("history_test");
+    return 1;
+  }
+  memset(flash, 0xFF, size);
+  partition_host_use(flash, size);
+
+  // Forked before the first history_begin(), so it starts with none of this
+  // run's RAM state, as after a reset
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("history_test");
+    return 1;
+  }
+  if (pid == 0) {
+    close(go[1]);
+    _exit(run_rebooted(go[0]));
+  }
+  close(go[0]);
+
+  check(history_begin(), "history_begin on an erased partition");
+  generate(true);
+  // capacity() is what survives a wrap; the head sector adds up to one more
+  check(history_count() >= history_capacity() && history_count() <= TEST_SECTORS * HISTORY_PER_SECTOR,
+        "record count after the wraps");
+  check_queries("query matches scan", 0);
+
+  uint32_t count = history_count();
+  if (write(go[1], &count, sizeof(count)) != sizeof(count)) {
+    perror("history_test");
+  }
+  close(go[1]);
+  int status;
+  waitpid(pid, &status, 0);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "reboot: rebuilt index gives the same answers");
+  printf("%d of %d history checks passed\n", checks - failures, checks);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// The host stand-ins follow the IDF 5 APIs
+#define ESP_IDF_VERSION_MAJOR 5
@@ -0,0 +1,47 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF partition API: one data partition backed by
+// a RAM buffer (see partition_host.cpp). Reads, writes and erases behave as
+// on NOR flash: erase sets bytes to 0xFF, a write can only clear bits.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+typedef int esp_partition_mmap_handle_t;
+
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#endif
+#define ESP_ERR_INVALID_ARG 0x102
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+
+typedef enum {
+  ESP_PARTITION_MMAP_DATA,
+  ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t len);
+esp_err_t esp_partition_mmap(const esp_partition_t *part, size_t offset, size_t len,
+                             esp_partition_mmap_memory_t memory, const void **out,
+                             esp_partition_mmap_handle_t *handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS bits the controller modules use. The
+// simulator runs one house per process on a single thread, so critical
+// sections are no-ops.
+
+#include <stdint.h>
+
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Task creation links but does nothing: the simulator calls the task bodies'
+// work functions (controller_tick, safety_check, ...) from its own loop
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+
+int xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, int priority,
+                            TaskHandle_t *handle, int core);
+TickType_t xTaskGetTickCount();
+void vTaskDelayUntil(TickType_t *wake, TickType_t ticks);
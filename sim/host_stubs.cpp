@@ -0,0 +1,152 @@
+#include <freertos/task.h>
+#include <nvs.h>
+#include <string.h>
+#include "console.h"
+#include "hal.h"
+#include "history.h"
+#include "host_stubs.h"
+#include "periods.h"
+
+// Firmware modules the controller calls but the simulator does not model.
+// One house runs per controller instance (a house_sim process or a copy of
+// libcontroller_sim.so loaded by sim_server), so this state needs no locking.
+
+HostCounters hostCounters;
+
+void console_register(const char *name, const char *help, ConsoleHandler fn) {}
+
+int xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, int priority,
+                            TaskHandle_t *handle, int core) {
+  return 0;
+}
+
+TickType_t xTaskGetTickCount() {
+  return hal_millis();
+}
+
+void vTaskDelayUntil(TickType_t *wake, TickType_t ticks) {}
+
+// Task periods start at their defaults; scenarios change them (`period`)
+static uint32_t periods[PERIOD_COUNT] = PERIOD_DEFAULTS;
+
+uint32_t period_ms(PeriodId id) {
+  return periods[id];
+}
+
+void host_period_set(PeriodId id, uint32_t ms) {
+  periods[id] = ms;
+}
+
+bool history_append(HistoryRecord *rec) {
+  hostCounters.historyRecords++;
+  if (rec->type == HISTORY_CONTROL) {
+    hostCounters.controlRecords++;
+  }
+  if (rec->type == HISTORY_EVENT && rec->event.code == EVENT_SAFETY) {
+    hostCounters.safetyEvents++;
+  }
+  return true;
+}
+
+bool history_log_event(uint16_t code, int16_t arg, int32_t value, const char *text) {
+  HistoryRecord rec = {};
+  rec.type = HISTORY_EVENT;
+  rec.event.code = code;
+  return history_append(&rec);
+}
+
+// NVS: a small in-memory store that starts out erased
+#define NVS_HOST_ENTRIES 16
+#define NVS_HOST_BLOB_MAX 64
+
+struct NvsEntry {
+  char ns[16];
+  char key[16];
+  uint8_t data[NVS_HOST_BLOB_MAX];
+  size_t len;
+};
+
+static NvsEntry entries[NVS_HOST_ENTRIES];
+static int entryCount = 0;
+static const char *handles[NVS_HOST_ENTRIES + 1];
+static int handleCount = 0;
+
+static NvsEntry *nvs_find(nvs_handle_t handle, const char *key, bool create) {
+  if (handle == 0 || (int)handle > handleCount) {
+    return NULL;
+  }
+  const char *ns = handles[handle - 1];
+  for (int i = 0; i < entryCount; i++) {
+    if (strcmp(entries[i].ns, ns) == 0 && strcmp(entries[i].key, key) == 0) {
+      return &entries[i];
+    }
+  }
+  if (!create || entryCount == NVS_HOST_ENTRIES) {
+    return NULL;
+  }
+  NvsEntry *e = &entries[entryCount++];
+  strncpy(e->ns, ns, sizeof(e->ns) - 1);
+  strncpy(e->key, key, sizeof(e->key) - 1);
+  return e;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out) {
+  bool exists = false;
+  for (int i = 0; i < entryCount; i++) {
+    exists |= strcmp(entries[i].ns, name) == 0;
+  }
+  if (mode == NVS_READONLY && !exists) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  for (int i = 0; i < handleCount; i++) {
+    if (strcmp(handles[i], name) == 0) {
+      *out = i + 1;
+      return ESP_OK;
+    }
+  }
+  if (handleCount == NVS_HOST_ENTRIES) {
+    return ESP_FAIL;
+  }
+  handles[handleCount++] = name;   // Namespaces are string literals in the firmware
+  *out = handleCount;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  hostCounters.nvsCommits++;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out) {
+  size_t len = sizeof(*out);
+  esp_err_t err = nvs_get_blob(handle, key, out, &len);
+  return err == ESP_OK && len != sizeof(*out) ? ESP_FAIL : err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+  return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *len) {
+  NvsEntry *e = nvs_find(handle, key, false);
+  if (e == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out != NULL) {
+    memcpy(out, e->data, e->len < *len ? e->len : *len);
+  }
+  *len = e->len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+  NvsEntry *e = nvs_find(handle, key, true);
+  if (e == NULL || len > NVS_HOST_BLOB_MAX) {
+    return ESP_FAIL;
+  }
+  memcpy(e->data, value, len);
+  e->len = len;
+  return ESP_OK;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include "periods.h"
+
+// Counters kept by the host versions of the history and NVS modules
+struct HostCounters {
+  uint32_t historyRecords;
+  uint32_t controlRecords;
+  uint32_t safetyEvents;
+  uint32_t nvsCommits;
+};
+
+extern HostCounters hostCounters;
+
+// The task period period_ms() returns
+void host_period_set(PeriodId id, uint32_t ms);
+
+// RS-485 coordination (coord_host.cpp): off, the unit runs standalone
+void coord_host_set(bool on);
@@ -0,0 +1,110 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "house.h"
+
+// Saturation vapour density in g/m3 (Magnus formula over water)
+static float saturation_g_m3(float c) {
+  return 216.7f * 6.112f * expf(17.62f * c / (243.12f + c)) / (273.15f + c);
+}
+
+void house_defaults(HouseParams *p) {
+  p->volumeM3 = 300;
+  p->indoorC = 21;
+  p->outdoorC = -5;
+  p->outdoorRh = 80;
+  p->airChangesPerH = 0.5;
+  p->windowAirChangesPerH = 6;
+  p->moistureGPerH = 150;
+  p->evaporationGPerH = 1200;
+  p->tankMl = 3000;
+  p->tankEmptyMl = 300;
+  p->refillMlPerMin = 2000;
+  p->startRh = 35;
+  p->startTankMl = 3000;
+  p->sensorNoiseRh = 0.3;
+}
+
+struct ParamName {
+  const char *name;
+  size_t offset;
+};
+
+static const ParamName paramNames[] = {
+    {"volume", offsetof(HouseParams, volumeM3)},
+    {"indoor", offsetof(HouseParams, indoorC)},
+    {"outdoor", offsetof(HouseParams, outdoorC)},
+    {"outdoor_rh", offsetof(HouseParams, outdoorRh)},
+    {"ach", offsetof(HouseParams, airChangesPerH)},
+    {"window_ach", offsetof(HouseParams, windowAirChangesPerH)},
+    {"moisture", offsetof(HouseParams, moistureGPerH)},
+    {"evaporation", offsetof(HouseParams, evaporationGPerH)},
+    {"tank", offsetof(HouseParams, tankMl)},
+    {"tank_empty", offsetof(HouseParams, tankEmptyMl)},
+    {"refill", offsetof(HouseParams, refillMlPerMin)},
+    {"start_rh", offsetof(HouseParams, startRh)},
+    {"start_tank", offsetof(HouseParams, startTankMl)},
+    {"noise", offsetof(HouseParams, sensorNoiseRh)},
+};
+
+bool house_param_set(HouseParams *p, const char *name, float value) {
+  for (size_t i = 0; i < sizeof(paramNames) / sizeof(paramNames[0]); i++) {
+    if (strcmp(paramNames[i].name, name) == 0) {
+      *(float *)((char *)p + paramNames[i].offset) = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void house_init(const HouseParams *p, HouseState *s) {
+  memset(s, 0, sizeof(*s));
+  s->waterG = p->volumeM3 * saturation_g_m3(p->indoorC) * p->startRh / 100;
+  s->tankMl = p->startTankMl;
+}
+
+float house_rh(const HouseParams *p, const HouseState *s) {
+  return 100 * s->waterG / (p->volumeM3 * saturation_g_m3(p->indoorC));
+}
+
+int house_float_level(const HouseParams *p, const HouseState *s) {
+  switch (s->floatOverride) {
+    case FLOAT_STUCK_EMPTY:
+      return HIGH;
+    case FLOAT_STUCK_OK:
+      return LOW;
+    default:
+      return s->tankMl < p->tankEmptyMl ? HIGH : LOW;
+  }
+}
+
+void house_step(const HouseParams *p, HouseState *s, int pumps, bool valveOpen) {
+  // The pumps wet the evaporator pad; what does not evaporate runs back into
+  // the tank, so the tank drains at the evaporation rate
+  float wantG = pumps * p->evaporationGPerH / 3600;
+  float evaporated = wantG < s->tankMl ? wantG : s->tankMl;
+  if (pumps > 0 && evaporated < wantG) {
+    s->dryPumpS += pumps;
+  }
+  s->tankMl -= evaporated;
+  s->pumpedMl += evaporated;
+
+  if (valveOpen) {
+    float inMl = p->refillMlPerMin / 60;
+    if (s->tankMl + inMl > p->tankMl) {
+      inMl = p->tankMl - s->tankMl;   // Overflow goes to the drain
+    }
+    s->tankMl += inMl;
+    s->refilledMl += inMl;
+  }
+
+  float ach = p->airChangesPerH + (s->windowOpen ? p->windowAirChangesPerH : 0);
+  float outdoorG = saturation_g_m3(p->outdoorC) * p->outdoorRh / 100;
+  float exchanged = ach / 3600 * (p->volumeM3 * outdoorG - s->waterG);
+  s->waterG += exchanged + p->moistureGPerH / 3600 + evaporated;
+  float maxG = p->volumeM3 * saturation_g_m3(p->indoorC);
+  if (s->waterG > maxG) {
+    s->waterG = maxG;   // Condensation on cold surfaces
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Single-zone moisture balance for the house the humidifier serves.
+//
+// The air holds volume * rho_s(T) * RH/100 grams of water. Each second it
+// gains the occupants' moisture and the evaporation of every running pump,
+// and exchanges air with the outdoors at the air change rate (plus the extra
+// rate of an open window). Outdoor air brings in rho_s(T_out) * RH_out/100.
+// The tank drains at the evaporation rate and refills through the valve at the supply
+// flow; the float reports empty below tankEmptyMl.
+
+struct HouseParams {
+  float volumeM3;
+  float indoorC;
+  float outdoorC;
+  float outdoorRh;
+  float airChangesPerH;
+  float windowAirChangesPerH;   // Added while a window is open
+  float moistureGPerH;          // Occupants, cooking, plants
+  float evaporationGPerH;       // Per running pump
+  float tankMl;
+  float tankEmptyMl;            // Float drops below this level
+  float refillMlPerMin;         // Supply flow through the open valve
+  float startRh;
+  float startTankMl;
+  float sensorNoiseRh;          // Uniform +-, added to every reading
+};
+
+void house_defaults(HouseParams *p);
+
+// Returns false if name is not a HouseParams field (names as in house_defaults)
+bool house_param_set(HouseParams *p, const char *name, float value);
+
+// Events that override the model or the inputs the controller sees
+enum FloatOverride { FLOAT_FREE, FLOAT_STUCK_EMPTY, FLOAT_STUCK_OK };
+
+struct HouseState {
+  float waterG;         // Water vapour in the air
+  float tankMl;
+  float pumpedMl;       // Total evaporated from the tank
+  float refilledMl;     // Total let in through the valve
+  float dryPumpS;       // Pump-seconds with an empty tank
+  bool windowOpen;
+  FloatOverride floatOverride;
+  bool sensorDropout;
+};
+
+void house_init(const HouseParams *p, HouseState *s);
+float house_rh(const HouseParams *p, const HouseState *s);
+
+// Float switch level as read on WATER_LEVEL_PIN, HIGH = empty
+int house_float_level(const HouseParams *p, const HouseState *s);
+
+// Advances one second with `pumps` pumps running and the valve open or closed
+void house_step(const HouseParams *p, HouseState *s, int pumps, bool valveOpen);
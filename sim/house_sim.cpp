@@ -0,0 +1,97 @@
+// Native house simulator: runs the firmware controller (src/controller.cpp and
+// the pump, gain and KPI modules it uses) against the moisture model in
+// house.cpp, driven by scenario scripts.
+//
+//   house_sim [--verbose] [--trace out.csv] [--house houses/x.house] scenarios/*.scn
+//
+// Every scenario runs in its own process, so the controller's globals and the
+// in-memory NVS start fresh each time. The exit status is 1 if any
+// expectation failed or a scenario did not load.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "controller_api.h"
+#include "sim_run.h"
+
+static void print_failure(const char *line, void *arg) {
+  printf("  FAIL %s\n", line);
+}
+
+static int run_scenario(const HouseFile *house, const Scenario *sc, FILE *trace) {
+  SimResult r;
+  sim_run(sim_controller(), &house->params, sc, trace, &r);
+  printf("%s in %s (%.1f days)\n", sc->name, house->name, sc->durationS / 86400.0);
+  for (int i = 0; i < SIM_METRICS; i++) {
+    printf("  %-16s %9.2f\n", r.metrics[i].name, r.metrics[i].value);
+  }
+  sim_check(sc, house->name, &r, print_failure, NULL);
+  printf("  %s (%d/%d expectations)\n", r.failed ? "FAILED" : "ok", r.checked - r.failed, r.checked);
+  return r.failed ? 1 : 0;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: house_sim [--verbose] [--trace out.csv] [--house file.house] scenario.scn...\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *tracePath = NULL;
+  const char *housePath = NULL;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; first++) {
+    if (strcmp(argv[first], "--verbose") == 0) {
+      sim_controller()->set_verbose(true);
+    } else if (strcmp(argv[first], "--trace") == 0 && first + 1 < argc) {
+      tracePath = argv[++first];
+    } else if (strcmp(argv[first], "--house") == 0 && first + 1 < argc) {
+      housePath = argv[++first];
+    } else {
+      usage();
+    }
+  }
+  if (first == argc || (tracePath != NULL && argc - first != 1)) {
+    usage();   // A trace covers exactly one scenario
+  }
+  HouseFile house;
+  char err[160];
+  if (housePath == NULL) {
+    house_defaults(&house.params);
+    snprintf(house.name, sizeof(house.name), "%s", SCENARIO_HOUSE_DEFAULT);
+  } else if (!house_load(housePath, &house, err, sizeof(err))) {
+    printf("%s\n", err);
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = first; i < argc; i++) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      static Scenario sc;
+      if (!scenario_load(argv[i], &sc, err, sizeof(err))) {
+        printf("%s\n", err);
+        exit(1);
+      }
+      FILE *trace = tracePath != NULL ? fopen(tracePath, "w") : NULL;
+      if (tracePath != NULL && trace == NULL) {
+        printf("cannot write %s\n", tracePath);
+        exit(1);
+      }
+      int rc = run_scenario(&house, &sc, trace);
+      if (trace != NULL) {
+        fclose(trace);
+      }
+      fflush(stdout);
+      exit(rc);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed++;
+    }
+  }
+  printf("%d of %d scenarios passed\n", argc - first - failed, argc - first);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#include <esp_partition.h>
+#include <string.h>
+#include "partition_host.h"
+
+static esp_partition_t part = {ESP_PARTITION_TYPE_DATA, 0, 0, 0, ""};
+static uint8_t *flash = NULL;
+
+void partition_host_use(uint8_t *buf, size_t size) {
+  flash = buf;
+  part.size = size;
+}
+
+static bool in_range(const esp_partition_t *p, size_t offset, size_t len) {
+  return p == &part && flash != NULL && offset <= part.size && len <= part.size - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  return flash != NULL && type == ESP_PARTITION_TYPE_DATA ? &part : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *dst, size_t len) {
+  if (!in_range(p, offset, len)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memcpy(dst, flash + offset, len);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *src, size_t len) {
+  if (!in_range(p, offset, len)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint8_t *in = (const uint8_t *)src;
+  for (size_t i = 0; i < len; i++) {
+    flash[offset + i] &= in[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t len) {
+  if (!in_range(p, offset, len) || offset % 4096 != 0 || len % 4096 != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(flash + offset, 0xFF, len);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t offset, size_t len,
+                             esp_partition_mmap_memory_t memory, const void **out,
+                             esp_partition_mmap_handle_t *handle) {
+  if (!in_range(p, offset, len)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out = flash + offset;
+  *handle = 0;
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {}
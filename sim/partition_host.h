@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Backs the host partition API with `flash`, which the caller owns. A
+// process that maps it shared sees what another one wrote, as a rebooted
+// unit sees its flash.
+void partition_host_use(uint8_t *flash, size_t size);
@@ -0,0 +1,366 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scenario.h"
+
+#define SCENARIO_LINE_MAX 160
+#define SCENARIO_MAX_TOKENS 10
+
+struct Parser {
+  const char *path;
+  int line;
+  char *err;
+  size_t errLen;
+};
+
+static bool fail(Parser *p, const char *fmt, ...) {
+  int n = snprintf(p->err, p->errLen, "%s:%d: ", p->path, p->line);
+  if (n < 0 || (size_t)n >= p->errLen) {
+    return false;   // The location alone filled err (truncated)
+  }
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(p->err + n, p->errLen - n, fmt, args);
+  va_end(args);
+  return false;
+}
+
+// "90s", "10m", "6h", "2d"; a bare number is seconds
+static bool parse_duration(const char *s, uint32_t *out) {
+  char *end;
+  unsigned long n = strtoul(s, &end, 10);
+  if (end == s) {
+    return false;
+  }
+  unsigned long scale = 1;
+  if (*end == 'm') {
+    scale = 60;
+  } else if (*end == 'h') {
+    scale = 3600;
+  } else if (*end == 'd') {
+    scale = 86400;
+  } else if (*end != 's' && *end != '\0') {
+    return false;
+  }
+  if (*end != '\0' && end[1] != '\0') {
+    return false;
+  }
+  *out = n * scale;
+  return true;
+}
+
+static bool parse_clock(const char *s, uint32_t *out) {
+  unsigned h, m;
+  char tail;
+  if (sscanf(s, "%u:%u%c", &h, &m, &tail) != 2 || h > 23 || m > 59) {
+    return false;
+  }
+  *out = h * 3600 + m * 60;
+  return true;
+}
+
+// Consumes one or two tokens: "HH:MM", "dN HH:MM" or a duration
+static bool parse_when(char **tok, int ntok, int *used, uint32_t *out) {
+  if (ntok >= 2 && tok[0][0] == 'd' && strchr(tok[1], ':') != NULL) {
+    char *end;
+    unsigned long day = strtoul(tok[0] + 1, &end, 10);
+    uint32_t clock;
+    if (*end != '\0' || day < 1 || !parse_clock(tok[1], &clock)) {
+      return false;
+    }
+    *out = (day - 1) * 86400 + clock;
+    *used = 2;
+    return true;
+  }
+  *used = 1;
+  return strchr(tok[0], ':') != NULL ? parse_clock(tok[0], out) : parse_duration(tok[0], out);
+}
+
+static bool add_event(Parser *p, Scenario *s, uint32_t atS, ScenarioAction action, const char *param, float value) {
+  if (s->eventCount == SCENARIO_MAX_EVENTS) {
+    return fail(p, "more than %d events", SCENARIO_MAX_EVENTS);
+  }
+  ScenarioEvent &e = s->events[s->eventCount++];
+  e.atS = atS;
+  e.action = action;
+  snprintf(e.param, sizeof(e.param), "%s", param ? param : "");
+  e.value = value;
+  return true;
+}
+
+// Optional trailing "for DUR" starting at tok[i]
+static bool parse_for(Parser *p, char **tok, int ntok, int i, bool *has, uint32_t *dur) {
+  *has = false;
+  if (i == ntok) {
+    return true;
+  }
+  if (ntok - i != 2 || strcmp(tok[i], "for") != 0 || !parse_duration(tok[i + 1], dur)) {
+    return fail(p, "expected 'for DURATION' after the action");
+  }
+  *has = true;
+  return true;
+}
+
+static bool parse_action(Parser *p, Scenario *s, uint32_t at, char **tok, int ntok) {
+  if (ntok == 0) {
+    return fail(p, "missing action");
+  }
+  bool hasFor;
+  uint32_t dur;
+  if (strcmp(tok[0], "window") == 0 && ntok >= 2 && (!strcmp(tok[1], "open") || !strcmp(tok[1], "close"))) {
+    float open = strcmp(tok[1], "open") == 0;
+    if (!parse_for(p, tok, ntok, 2, &hasFor, &dur) || !add_event(p, s, at, ACTION_WINDOW, NULL, open)) {
+      return false;
+    }
+    return !hasFor || add_event(p, s, at + dur, ACTION_WINDOW, NULL, !open);
+  }
+  if (strcmp(tok[0], "float") == 0 && ntok == 2 && strcmp(tok[1], "free") == 0) {
+    return add_event(p, s, at, ACTION_FLOAT, NULL, FLOAT_FREE);
+  }
+  if (strcmp(tok[0], "float") == 0 && ntok >= 3 && strcmp(tok[1], "stuck") == 0 &&
+      (!strcmp(tok[2], "empty") || !strcmp(tok[2], "ok"))) {
+    FloatOverride mode = strcmp(tok[2], "empty") == 0 ? FLOAT_STUCK_EMPTY : FLOAT_STUCK_OK;
+    if (!parse_for(p, tok, ntok, 3, &hasFor, &dur) || !add_event(p, s, at, ACTION_FLOAT, NULL, mode)) {
+      return false;
+    }
+    return !hasFor || add_event(p, s, at + dur, ACTION_FLOAT, NULL, FLOAT_FREE);
+  }
+  if (strcmp(tok[0], "coord") == 0 && ntok >= 2 && (!strcmp(tok[1], "on") || !strcmp(tok[1], "off"))) {
+    float on = strcmp(tok[1], "on") == 0;
+    if (!parse_for(p, tok, ntok, 2, &hasFor, &dur) || !add_event(p, s, at, ACTION_COORD, NULL, on)) {
+      return false;
+    }
+    return !hasFor || add_event(p, s, at + dur, ACTION_COORD, NULL, !on);
+  }
+  if (strcmp(tok[0], "period") == 0 && ntok == 3) {
+    if (strcmp(tok[1], "sensor") != 0 && strcmp(tok[1], "level") != 0 && strcmp(tok[1], "control") != 0) {
+      return fail(p, "unknown task '%s'", tok[1]);
+    }
+    if (!parse_duration(tok[2], &dur) || dur == 0) {
+      return fail(p, "bad period '%s'", tok[2]);
+    }
+    return add_event(p, s, at, ACTION_PERIOD, tok[1], dur * 1000.0f);
+  }
+  if (strcmp(tok[0], "sensor") == 0 && ntok == 3 && strcmp(tok[1], "dropout") == 0) {
+    if (!parse_duration(tok[2], &dur)) {
+      return fail(p, "bad duration '%s'", tok[2]);
+    }
+    return add_event(p, s, at, ACTION_DROPOUT, NULL, 1) && add_event(p, s, at + dur, ACTION_DROPOUT, NULL, 0);
+  }
+  if (strcmp(tok[0], "set") == 0 && ntok == 3) {
+    HouseParams check;
+    house_defaults(&check);
+    if (!house_param_set(&check, tok[1], strtof(tok[2], NULL))) {
+      return fail(p, "unknown parameter '%s'", tok[1]);
+    }
+    return add_event(p, s, at, ACTION_SET, tok[1], strtof(tok[2], NULL));
+  }
+  return fail(p, "unknown action '%s'", tok[0]);
+}
+
+static bool parse_expect(Parser *p, Scenario *s, char **tok, int ntok) {
+  static const char *ops[] = {"<", "<=", ">", ">=", "=="};
+  if (ntok != 4 && !(ntok == 6 && strcmp(tok[4], "in") == 0)) {
+    return fail(p, "expected 'expect METRIC OP VALUE [in HOUSES]'");
+  }
+  if (s->expectCount == SCENARIO_MAX_EXPECTS) {
+    return fail(p, "more than %d expectations", SCENARIO_MAX_EXPECTS);
+  }
+  ScenarioExpect &e = s->expects[s->expectCount];
+  int op = -1;
+  for (int i = 0; i < 5; i++) {
+    if (strcmp(tok[2], ops[i]) == 0) {
+      op = i;
+    }
+  }
+  if (op < 0) {
+    return fail(p, "unknown comparison '%s'", tok[2]);
+  }
+  snprintf(e.metric, sizeof(e.metric), "%s", tok[1]);
+  e.op = (ExpectOp)op;
+  e.value = strtof(tok[3], NULL);
+  snprintf(e.houses, sizeof(e.houses), "%s", ntok == 6 ? tok[5] : "*");
+  e.line = p->line;
+  s->expectCount++;
+  return true;
+}
+
+// Splits a line into words up to a '#' comment; false if there are too many
+static bool tokenize(Parser *p, char *line, char **tok, int *ntok) {
+  char *save;
+  *ntok = 0;
+  for (char *t = strtok_r(line, " \t\r\n", &save); t != NULL && t[0] != '#'; t = strtok_r(NULL, " \t\r\n", &save)) {
+    if (*ntok == SCENARIO_MAX_TOKENS) {
+      return fail(p, "too many words");
+    }
+    tok[(*ntok)++] = t;
+  }
+  return true;
+}
+
+static bool parse_set(Parser *p, HouseParams *params, char **tok, int ntok) {
+  if (ntok != 3 || !house_param_set(params, tok[1], strtof(tok[2], NULL))) {
+    return fail(p, "expected 'set PARAM VALUE' with a house parameter");
+  }
+  return true;
+}
+
+static bool parse_line(Parser *p, Scenario *s, char *line) {
+  char *tok[SCENARIO_MAX_TOKENS];
+  int ntok;
+  if (!tokenize(p, line, tok, &ntok)) {
+    return false;
+  }
+  if (ntok == 0) {
+    return true;
+  }
+  if (strcmp(tok[0], "duration") == 0) {
+    if (ntok != 2 || !parse_duration(tok[1], &s->durationS)) {
+      return fail(p, "expected 'duration DURATION'");
+    }
+    return true;
+  }
+  if (strcmp(tok[0], "set") == 0) {
+    HouseParams check;
+    house_defaults(&check);
+    if (!parse_set(p, &check, tok, ntok)) {
+      return false;
+    }
+    if (s->settingCount == SCENARIO_MAX_SETTINGS) {
+      return fail(p, "more than %d settings", SCENARIO_MAX_SETTINGS);
+    }
+    ScenarioSetting &set = s->settings[s->settingCount++];
+    snprintf(set.param, sizeof(set.param), "%s", tok[1]);
+    set.value = strtof(tok[2], NULL);
+    return true;
+  }
+  if (strcmp(tok[0], "at") == 0) {
+    uint32_t at;
+    int used;
+    if (ntok < 3 || !parse_when(tok + 1, ntok - 1, &used, &at)) {
+      return fail(p, "expected 'at TIME ACTION'");
+    }
+    return parse_action(p, s, at, tok + 1 + used, ntok - 1 - used);
+  }
+  if (strcmp(tok[0], "expect") == 0) {
+    return parse_expect(p, s, tok, ntok);
+  }
+  return fail(p, "unknown keyword '%s'", tok[0]);
+}
+
+// Insertion sort: stable, and the lists are short
+static void sort_events(Scenario *s) {
+  for (int i = 1; i < s->eventCount; i++) {
+    ScenarioEvent e = s->events[i];
+    int j = i;
+    while (j > 0 && s->events[j - 1].atS > e.atS) {
+      s->events[j] = s->events[j - 1];
+      j--;
+    }
+    s->events[j] = e;
+  }
+}
+
+// File name without directory and extension
+static void name_from_path(const char *path, char *name, size_t len) {
+  const char *base = strrchr(path, '/');
+  snprintf(name, len, "%s", base ? base + 1 : path);
+  char *dot = strrchr(name, '.');
+  if (dot != NULL) {
+    *dot = '\0';
+  }
+}
+
+bool scenario_load(const char *path, Scenario *out, char *err, size_t errLen) {
+  memset(out, 0, sizeof(*out));
+  out->durationS = 86400;
+  name_from_path(path, out->name, sizeof(out->name));
+
+  Parser p = {path, 0, err, errLen};
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return fail(&p, "cannot open");
+  }
+  char line[SCENARIO_LINE_MAX];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    p.line++;
+    ok = parse_line(&p, out, line);
+  }
+  fclose(f);
+  if (!ok) {
+    return false;
+  }
+  sort_events(out);
+  if (out->eventCount > 0 && out->events[out->eventCount - 1].atS >= out->durationS) {
+    p.line = 0;
+    return fail(&p, "event at %us is after the end of the scenario", (unsigned)out->events[out->eventCount - 1].atS);
+  }
+  return true;
+}
+
+bool house_load(const char *path, HouseFile *out, char *err, size_t errLen) {
+  house_defaults(&out->params);
+  name_from_path(path, out->name, sizeof(out->name));
+
+  Parser p = {path, 0, err, errLen};
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return fail(&p, "cannot open");
+  }
+  char line[SCENARIO_LINE_MAX];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    p.line++;
+    char *tok[SCENARIO_MAX_TOKENS];
+    int ntok;
+    ok = tokenize(&p, line, tok, &ntok);
+    if (ok && ntok > 0) {
+      ok = strcmp(tok[0], "set") == 0 ? parse_set(&p, &out->params, tok, ntok)
+                                      : fail(&p, "a house file only has 'set' lines");
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+void scenario_house(const Scenario *s, const HouseParams *house, HouseParams *out) {
+  *out = *house;
+  for (int i = 0; i < s->settingCount; i++) {
+    house_param_set(out, s->settings[i].param, s->settings[i].value);
+  }
+}
+
+void scenario_cursor_init(ScenarioCursor *c, const Scenario *s) {
+  c->scenario = s;
+  c->next = 0;
+}
+
+const ScenarioEvent *scenario_next_due(ScenarioCursor *c, uint32_t nowS) {
+  const Scenario *s = c->scenario;
+  if (c->next < s->eventCount && s->events[c->next].atS <= nowS) {
+    return &s->events[c->next++];
+  }
+  return NULL;
+}
+
+bool scenario_expect_holds(const ScenarioExpect *e, float actual) {
+  switch (e->op) {
+    case EXPECT_LT:
+      return actual < e->value;
+    case EXPECT_LE:
+      return actual <= e->value;
+    case EXPECT_GT:
+      return actual > e->value;
+    case EXPECT_GE:
+      return actual >= e->value;
+    default:
+      return actual == e->value;
+  }
+}
+
+const char *scenario_op_name(ExpectOp op) {
+  static const char *names[] = {"<", "<=", ">", ">=", "=="};
+  return names[op];
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "house.h"
+
+// Scenario scripts for the house simulator, one file per scenario:
+//
+//   # Window left open in the afternoon
+//   duration 2d
+//   set outdoor -10
+//   at 14:00 window open for 2h
+//   at d3 08:00 float stuck empty for 6h
+//   at d1 09:30 sensor dropout 10m
+//   expect rh_min >= 38
+//
+// Times are HH:MM on day 1, dN HH:MM on day N, or an offset such as 90s,
+// 10m, 6h or 2d from the start (midnight of day 1). Actions:
+//   window open|close [for DUR]
+//   float stuck empty|ok [for DUR]  /  float free
+//   sensor dropout DUR
+//   coord on|off [for DUR]          (unit takes its duty from a coordinator)
+//   period sensor|level|control DUR (task period, whole seconds)
+//   set PARAM VALUE                 (house_defaults names)
+// An expectation that only holds for some houses ends in `in PATTERN`, for
+// example `expect rh_mean < 45 in reference`. house_sim's house is called
+// reference unless --house names another.
+// A `for DUR` adds the matching end event. Loading compiles everything into
+// one timeline sorted by time (ties keep file order), so the simulation only
+// compares the next event's time each second.
+
+#define SCENARIO_MAX_EVENTS 64
+#define SCENARIO_MAX_EXPECTS 16
+#define SCENARIO_MAX_SETTINGS 16
+#define SCENARIO_NAME_MAX 32
+#define SCENARIO_HOUSE_DEFAULT "reference"   // house_defaults() as is
+
+enum ScenarioAction : uint8_t {
+  ACTION_WINDOW,     // value 1 = open, 0 = closed
+  ACTION_FLOAT,      // value = FloatOverride
+  ACTION_DROPOUT,    // value 1 = sensor stops answering, 0 = back
+  ACTION_SET,        // param = value
+  ACTION_COORD,      // value 1 = coordinated, 0 = standalone
+  ACTION_PERIOD,     // param = task, value = ms
+};
+
+struct ScenarioEvent {
+  uint32_t atS;
+  ScenarioAction action;
+  char param[16];
+  float value;
+};
+
+enum ExpectOp : uint8_t { EXPECT_LT, EXPECT_LE, EXPECT_GT, EXPECT_GE, EXPECT_EQ };
+
+struct ScenarioExpect {
+  char metric[16];
+  ExpectOp op;
+  float value;
+  char houses[SCENARIO_NAME_MAX];   // Shell pattern of the houses it holds for
+  int line;
+};
+
+// A top-level `set` line, applied to whichever house the scenario runs in
+struct ScenarioSetting {
+  char param[16];
+  float value;
+};
+
+struct Scenario {
+  char name[SCENARIO_NAME_MAX];
+  uint32_t durationS;
+  ScenarioSetting settings[SCENARIO_MAX_SETTINGS];
+  int settingCount;
+  ScenarioEvent events[SCENARIO_MAX_EVENTS];
+  int eventCount;
+  ScenarioExpect expects[SCENARIO_MAX_EXPECTS];
+  int expectCount;
+};
+
+// Parses and compiles a scenario file. On error returns false with the file,
+// line and reason in err.
+bool scenario_load(const char *path, Scenario *out, char *err, size_t errLen);
+
+// The house a scenario runs in: `house`, then the scenario's `set` lines
+void scenario_house(const Scenario *s, const HouseParams *house, HouseParams *out);
+
+// A digital-twin house: a file of `set` lines over house_defaults(), named
+// after the file. sim_server's catalog is sim/houses/*.house.
+struct HouseFile {
+  char name[SCENARIO_NAME_MAX];
+  HouseParams params;
+};
+
+bool house_load(const char *path, HouseFile *out, char *err, size_t errLen);
+
+// Walks the compiled timeline: each call returns the next event due at or
+// before nowS, or NULL, in O(1)
+struct ScenarioCursor {
+  const Scenario *scenario;
+  int next;
+};
+
+void scenario_cursor_init(ScenarioCursor *c, const Scenario *s);
+const ScenarioEvent *scenario_next_due(ScenarioCursor *c, uint32_t nowS);
+
+// true when `actual op value` holds
+bool scenario_expect_holds(const ScenarioExpect *e, float actual);
+const char *scenario_op_name(ExpectOp op);
@@ -0,0 +1,176 @@
+#include <fnmatch.h>
+#include <math.h>
+#include <string.h>
+#include "sim_run.h"
+
+struct Metrics {
+  float rhMin;
+  float rhMax;
+  double rhSum;
+  uint32_t samples;
+  uint32_t inBandS;
+  uint32_t valveCycles;
+  uint32_t pumpS;
+};
+
+// Deterministic noise, so runs are reproducible
+static float noise(uint32_t *state, float amplitude) {
+  *state = *state * 1103515245u + 12345u;
+  return amplitude * (((*state >> 8) & 0xFFFF) / 32767.5f - 1);
+}
+
+static void apply_event(const SimController *ctl, const ScenarioEvent *e, HouseParams *params, HouseState *house,
+                        uint32_t *periods) {
+  switch (e->action) {
+    case ACTION_WINDOW:
+      house->windowOpen = e->value != 0;
+      break;
+    case ACTION_FLOAT:
+      house->floatOverride = (FloatOverride)(int)e->value;
+      break;
+    case ACTION_DROPOUT:
+      house->sensorDropout = e->value != 0;
+      break;
+    case ACTION_SET:
+      house_param_set(params, e->param, e->value);
+      break;
+    case ACTION_COORD:
+      ctl->set_coordinated(e->value != 0);
+      break;
+    case ACTION_PERIOD: {
+      int id = strcmp(e->param, "sensor") == 0 ? SIM_PERIOD_SENSOR
+               : strcmp(e->param, "level") == 0 ? SIM_PERIOD_LEVEL
+                                                : SIM_PERIOD_CONTROL;
+      periods[id] = (uint32_t)e->value;
+      ctl->set_period(id, periods[id]);
+      break;
+    }
+  }
+}
+
+void sim_run(const SimController *ctl, const HouseParams *houseParams, const Scenario *sc, FILE *trace,
+             SimResult *out) {
+  HouseParams params;
+  scenario_house(sc, houseParams, &params);
+  HouseState house;
+  house_init(&params, &house);
+  ScenarioCursor cursor;
+  scenario_cursor_init(&cursor, sc);
+  uint32_t noiseState = 1;
+  uint32_t periods[SIM_PERIODS] = {ctl->sensorPeriodMs, ctl->levelPeriodMs, ctl->controlPeriodMs};
+
+  ctl->begin();
+
+  Metrics m = {1000, -1000, 0, 0, 0, 0, 0};
+  bool valveWas = false;
+  if (trace != NULL) {
+    fprintf(trace, "t_s,rh,rh_seen,tank_ml,pumps,valve,window,float,dropout,pump_state,countdown\n");
+  }
+
+  for (uint32_t t = 0; t < sc->durationS; t++) {
+    uint32_t ms = t * 1000;
+    ctl->set_ms(ms);
+    const ScenarioEvent *e;
+    while ((e = scenario_next_due(&cursor, t)) != NULL) {
+      apply_event(ctl, e, &params, &house, periods);
+    }
+
+    // The same call pattern as the firmware tasks, at their current periods
+    float rh = house_rh(&params, &house);
+    if (ms % periods[SIM_PERIOD_SENSOR] == 0 && !house.sensorDropout) {
+      ctl->reading(params.indoorC, rh + noise(&noiseState, params.sensorNoiseRh));
+    }
+    ctl->set_float(house_float_level(&params, &house));
+    if (ms % periods[SIM_PERIOD_LEVEL] == 0) {
+      ctl->sample_level();
+    }
+    if (ms % periods[SIM_PERIOD_CONTROL] == 0) {
+      ctl->tick(periods[SIM_PERIOD_CONTROL] / 1000);
+    }
+    // The supervisor samples once per simulated second instead of every
+    // SAFETY_PERIOD_MS; the interlocks it checks are the same
+    ctl->supervise((int64_t)t * 1000000);
+
+    // What the outputs actually do, as the house sees it
+    int pumps = ctl->pumps_running();
+    bool valve = ctl->valve_open();
+    m.valveCycles += valve && !valveWas;
+    valveWas = valve;
+    m.pumpS += pumps;
+
+    if (t >= SIM_SETTLE_S) {
+      m.rhMin = rh < m.rhMin ? rh : m.rhMin;
+      m.rhMax = rh > m.rhMax ? rh : m.rhMax;
+      m.rhSum += rh;
+      m.samples++;
+      m.inBandS += fabsf(rh - ctl->targetRh) <= ctl->bandRh;
+    }
+    if (trace != NULL && t % 60 == 0) {
+      SimControllerStatus st;
+      ctl->status(&st);
+      fprintf(trace, "%u,%.2f,%.2f,%.0f,%d,%d,%d,%d,%d,%d,%d\n", (unsigned)t, rh, st.humidity, house.tankMl, pumps,
+              valve, house.windowOpen, house.floatOverride, house.sensorDropout, st.pumpState, st.countdown);
+    }
+    house_step(&params, &house, pumps, valve);
+  }
+
+  SimControllerStatus st;
+  ctl->status(&st);
+  float samples = m.samples ? m.samples : 1;
+  const MetricValue metrics[SIM_METRICS] = {
+      {"rh_min", m.rhMin},
+      {"rh_max", m.rhMax},
+      {"rh_mean", (float)(m.rhSum / samples)},
+      {"rh_end", house_rh(&params, &house)},
+      {"in_band_pct", 100 * m.inBandS / samples},
+      {"pump_starts", (float)st.pumpStarts},
+      {"pump_min", m.pumpS / 60.0f},
+      {"water_l", house.pumpedMl / 1000},
+      {"refill_l", house.refilledMl / 1000},
+      {"valve_cycles", (float)m.valveCycles},
+      {"dry_pump_min", house.dryPumpS / 60},
+      {"tank_end_l", house.tankMl / 1000},
+      {"control_records", (float)st.controlRecords},
+      {"safety_trips", (float)st.safetyEvents},
+  };
+  memcpy(out->metrics, metrics, sizeof(metrics));
+  out->checked = 0;
+  out->failed = 0;
+}
+
+bool sim_metric(const SimResult *r, const char *name, float *value) {
+  for (int i = 0; i < SIM_METRICS; i++) {
+    if (strcmp(r->metrics[i].name, name) == 0) {
+      *value = r->metrics[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void sim_check(const Scenario *sc, const char *house, SimResult *r, void (*describe)(const char *line, void *arg),
+               void *arg) {
+  r->checked = 0;
+  r->failed = 0;
+  for (int i = 0; i < sc->expectCount; i++) {
+    const ScenarioExpect &x = sc->expects[i];
+    if (fnmatch(x.houses, house, 0) != 0) {
+      continue;
+    }
+    r->checked++;
+    char line[96];
+    float value;
+    if (!sim_metric(r, x.metric, &value)) {
+      snprintf(line, sizeof(line), "line %d: unknown metric %s", x.line, x.metric);
+    } else if (!scenario_expect_holds(&x, value)) {
+      snprintf(line, sizeof(line), "line %d: %s %s %g, got %.2f", x.line, x.metric, scenario_op_name(x.op), x.value,
+               value);
+    } else {
+      continue;
+    }
+    r->failed++;
+    if (describe != NULL) {
+      describe(line, arg);
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include "controller_api.h"
+#include "house.h"
+#include "scenario.h"
+
+// One scenario in one house against one controller instance: the loop that
+// house_sim and sim_server share.
+
+#define SIM_SETTLE_S 21600    // Comfort metrics ignore the first 6 h (start-up from start_rh)
+#define SIM_METRICS 14
+
+struct MetricValue {
+  const char *name;
+  float value;
+};
+
+struct SimResult {
+  MetricValue metrics[SIM_METRICS];
+  int checked;  // Expectations that apply to the house
+  int failed;   // Of those, the ones that did not hold
+};
+
+// Runs the scenario from a fresh controller_begin(). The controller must be a
+// fresh instance. trace, if not NULL, gets one CSV line per simulated minute.
+void sim_run(const SimController *ctl, const HouseParams *house, const Scenario *sc, FILE *trace, SimResult *out);
+
+// Returns the metric's value, or false if there is no metric of that name
+bool sim_metric(const SimResult *r, const char *name, float *value);
+
+// Checks every expectation that applies to the house and sets r->failed and
+// r->checked. describe, if not NULL, is called for each one that failed with
+// a line such as "line 7: rh_min >= 47, got 45.20"
+void sim_check(const Scenario *sc, const char *house, SimResult *r, void (*describe)(const char *line, void *arg),
+               void *arg);
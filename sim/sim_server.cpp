@@ -0,0 +1,494 @@
+// Simulation server for controller CI: runs controller builds against a
+// catalog of digital-twin houses and scenarios, many houses at a time.
+//
+//   sim_server serve [--socket PATH] [--threads N] [--houses DIR] [--scenarios DIR]
+//   sim_server submit [--socket PATH] libcontroller_sim.so [HOUSES [SCENARIOS]]
+//
+// The catalog is sim/houses/*.house x sim/scenarios/*.scn unless --houses or
+// --scenarios point elsewhere; threads default to one per core.
+//
+// The server listens on a Unix socket only (mode 0600), so it is reachable
+// from the same machine and user. A client sends one line:
+//
+//   run LIB [HOUSES [SCENARIOS]]    every house x scenario pair whose names
+//                                   match the shell patterns (default *)
+//   catalog                         the houses and scenarios on offer
+//
+// Each pair is one job on a work-stealing pool (work_pool.h). A job loads a
+// private copy of LIB (controller_lib.h), so runs share no controller state,
+// and it writes its result as soon as it finishes. The server re-reads the
+// catalog for every request, so edits to the house and scenario files take
+// effect without a restart. The reply is JSON lines:
+//
+//   {"queued":24,"threads":8,"build":"..."}
+//   {"house":"...","scenario":"...","ok":false,"ms":310,"metrics":{...},"failures":["line 7: ..."]}
+//   {"done":true,"runs":24,"passed":23,"failed":1,"errors":0,"seconds":4.1}
+//
+// or a single {"error":"..."} line. `submit` prints the reply on stdout and
+// exits 1 unless every run passed.
+
+#include <fnmatch.h>
+#include <glob.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include "controller_lib.h"
+#include "sim_run.h"
+#include "work_pool.h"
+
+#ifndef SIM_CATALOG_DIR
+#define SIM_CATALOG_DIR "."   // CMake sets the sim/ source directory
+#endif
+
+#define SERVER_SOCKET "/tmp/house_sim.sock"
+#define SERVER_LINE_MAX 1024
+#define SERVER_REQUEST_TIMEOUT_S 10
+#define SERVER_SEND_TIMEOUT_S 5   // A client this far behind is dropped
+
+struct Request;
+
+struct Job {
+  Request *req;
+  const HouseFile *house;
+  const Scenario *scenario;
+};
+
+// One `run` request; the job that finishes last replies `done` and frees it
+struct Request {
+  int fd;
+  std::string lib;
+  std::vector<HouseFile> houses;
+  std::vector<Scenario> scenarios;
+  std::vector<Job> jobs;
+  double startS;
+  std::mutex lock;   // Writes to fd and the fields below
+  bool dead;         // A write failed or timed out; later results are dropped
+  size_t remaining;
+  int passed;
+  int failed;
+  int errors;
+};
+
+static const char *housesDir = SIM_CATALOG_DIR "/houses";
+static const char *scenariosDir = SIM_CATALOG_DIR "/scenarios";
+static const char *socketPath = SERVER_SOCKET;
+static WorkPool *pool = NULL;
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void json_string(std::string *out, const char *s) {
+  *out += '"';
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      *out += '\\';
+      *out += *s;
+    } else if ((unsigned char)*s < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", *s);
+      *out += esc;
+    } else {
+      *out += *s;
+    }
+  }
+  *out += '"';
+}
+
+static void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string *out, const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  *out += buf;
+}
+
+// Returns false if the client went away or stopped reading for
+// SERVER_SEND_TIMEOUT_S (SO_SNDTIMEO, set in handle_client)
+static bool send_line(int fd, std::string line) {
+  line += '\n';
+  const char *p = line.data();
+  size_t left = line.size();
+  while (left > 0) {
+    ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+// Under req->lock. A client that stops reading costs one worker at most
+// SERVER_SEND_TIMEOUT_S once; after that its results are dropped, so the
+// pool keeps serving the other clients.
+static void send_result(Request *req, const std::string &line) {
+  if (!req->dead && !send_line(req->fd, line)) {
+    req->dead = true;
+    printf("%s: client stopped reading, dropping its results\n", req->lib.c_str());
+    fflush(stdout);
+  }
+}
+
+static void send_error(int fd, const char *msg) {
+  std::string line = "{\"error\":";
+  json_string(&line, msg);
+  line += '}';
+  send_line(fd, line);
+}
+
+// Catalog
+
+// Sorted paths matching pattern (glob(3) sorts)
+static std::vector<std::string> list_files(const char *dir, const char *ext) {
+  std::vector<std::string> paths;
+  std::string pattern = std::string(dir) + "/*" + ext;
+  glob_t g;
+  if (glob(pattern.c_str(), 0, NULL, &g) == 0) {
+    for (size_t i = 0; i < g.gl_pathc; i++) {
+      paths.push_back(g.gl_pathv[i]);
+    }
+  }
+  globfree(&g);
+  return paths;
+}
+
+static bool load_catalog(Request *req, const char *housePattern, const char *scenarioPattern, char *err,
+                         size_t errLen) {
+  for (const std::string &path : list_files(housesDir, ".house")) {
+    HouseFile h;
+    if (!house_load(path.c_str(), &h, err, errLen)) {
+      return false;
+    }
+    if (fnmatch(housePattern, h.name, 0) == 0) {
+      req->houses.push_back(h);
+    }
+  }
+  for (const std::string &path : list_files(scenariosDir, ".scn")) {
+    req->scenarios.push_back(Scenario());   // Loaded in place, it is a few KB
+    Scenario &sc = req->scenarios.back();
+    if (!scenario_load(path.c_str(), &sc, err, errLen)) {
+      return false;
+    }
+    if (fnmatch(scenarioPattern, sc.name, 0) != 0) {
+      req->scenarios.pop_back();
+    }
+  }
+  if (req->houses.empty() || req->scenarios.empty()) {
+    snprintf(err, errLen, "no %s match (%s/*.house '%s', %s/*.scn '%s')",
+             req->houses.empty() ? "houses" : "scenarios", housesDir, housePattern, scenariosDir, scenarioPattern);
+    return false;
+  }
+  return true;
+}
+
+// Jobs
+
+static void send_done(Request *req) {
+  std::string line;
+  appendf(&line, "{\"done\":true,\"runs\":%u,\"passed\":%d,\"failed\":%d,\"errors\":%d,\"seconds\":%.1f}",
+          (unsigned)req->jobs.size(), req->passed, req->failed, req->errors, now_s() - req->startS);
+  send_result(req, line);
+  WorkPoolStats stats = pool->stats();
+  printf("%s: %d of %u runs passed in %.1f s (pool: %llu jobs, %llu stolen)\n", req->lib.c_str(), req->passed,
+         (unsigned)req->jobs.size(), now_s() - req->startS, (unsigned long long)stats.executed,
+         (unsigned long long)stats.stolen);
+  fflush(stdout);
+}
+
+static void collect_failure(const char *line, void *arg) {
+  std::string *failures = (std::string *)arg;
+  *failures += failures->empty() ? "" : ",";
+  json_string(failures, line);
+}
+
+static void run_job(void *arg) {
+  Job *job = (Job *)arg;
+  Request *req = job->req;
+  double start = now_s();
+
+  std::string line = "{\"house\":";
+  json_string(&line, job->house->name);
+  line += ",\"scenario\":";
+  json_string(&line, job->scenario->name);
+
+  ControllerLib lib;
+  char err[256];
+  bool loaded = controller_lib_open(req->lib.c_str(), &lib, err, sizeof(err));
+  SimResult r;
+  std::string failures;
+  if (loaded) {
+    sim_run(lib.api, &job->house->params, job->scenario, NULL, &r);
+    controller_lib_close(&lib);
+    sim_check(job->scenario, job->house->name, &r, collect_failure, &failures);
+    appendf(&line, ",\"ok\":%s,\"ms\":%.0f,\"metrics\":{", r.failed ? "false" : "true", (now_s() - start) * 1000);
+    for (int i = 0; i < SIM_METRICS; i++) {
+      appendf(&line, "%s\"%s\":%.2f", i ? "," : "", r.metrics[i].name, r.metrics[i].value);
+    }
+    line += "},\"failures\":[" + failures + "]}";
+  } else {
+    line += ",\"error\":";
+    json_string(&line, err);
+    line += '}';
+  }
+
+  bool last;
+  {
+    std::lock_guard<std::mutex> guard(req->lock);
+    send_result(req, line);
+    if (!loaded) {
+      req->errors++;
+    } else if (r.failed) {
+      req->failed++;
+    } else {
+      req->passed++;
+    }
+    last = --req->remaining == 0;
+    if (last) {
+      send_done(req);
+    }
+  }
+  if (last) {
+    close(req->fd);
+    delete req;
+  }
+}
+
+// Requests
+
+static void handle_catalog(int fd) {
+  Request req;
+  char err[256];
+  if (!load_catalog(&req, "*", "*", err, sizeof(err))) {
+    send_error(fd, err);
+    return;
+  }
+  std::string line = "{\"houses\":[";
+  for (size_t i = 0; i < req.houses.size(); i++) {
+    line += i ? "," : "";
+    json_string(&line, req.houses[i].name);
+  }
+  line += "],\"scenarios\":[";
+  for (size_t i = 0; i < req.scenarios.size(); i++) {
+    line += i ? "," : "";
+    json_string(&line, req.scenarios[i].name);
+  }
+  line += "]}";
+  send_line(fd, line);
+}
+
+// Returns true if the request now belongs to the pool (which closes fd)
+static bool handle_run(int fd, char **tok, int ntok) {
+  Request *req = new Request();
+  req->fd = fd;
+  req->lib = tok[1];
+  req->startS = now_s();
+  req->dead = false;
+  req->passed = req->failed = req->errors = 0;
+  char err[256];
+  ControllerLib lib;
+  if (!load_catalog(req, ntok > 2 ? tok[2] : "*", ntok > 3 ? tok[3] : "*", err, sizeof(err)) ||
+      !controller_lib_open(tok[1], &lib, err, sizeof(err))) {
+    send_error(fd, err);
+    delete req;
+    return false;
+  }
+  std::string header;
+  appendf(&header, "{\"queued\":%u,\"threads\":%d,\"build\":",
+          (unsigned)(req->houses.size() * req->scenarios.size()), pool->size());
+  json_string(&header, lib.api->build);
+  header += '}';
+  controller_lib_close(&lib);
+  req->dead = !send_line(fd, header);
+
+  for (const HouseFile &h : req->houses) {
+    for (const Scenario &sc : req->scenarios) {
+      Job job = {req, &h, &sc};
+      req->jobs.push_back(job);
+    }
+  }
+  // Longest scenarios first, so the short ones fill in at the end
+  std::stable_sort(req->jobs.begin(), req->jobs.end(),
+                   [](const Job &a, const Job &b) { return a.scenario->durationS > b.scenario->durationS; });
+  req->remaining = req->jobs.size();
+  printf("%s: %u runs\n", req->lib.c_str(), (unsigned)req->jobs.size());
+  fflush(stdout);
+
+  std::vector<WorkItem> items;
+  for (Job &job : req->jobs) {
+    WorkItem item = {run_job, &job};
+    items.push_back(item);
+  }
+  pool->submit(items.data(), items.size());
+  return true;
+}
+
+static void handle_client(int fd) {
+  struct timeval timeout = {SERVER_REQUEST_TIMEOUT_S, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  // Workers write results; they must not block on a client that stopped reading
+  struct timeval sendTimeout = {SERVER_SEND_TIMEOUT_S, 0};
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+  char line[SERVER_LINE_MAX];
+  size_t len = 0;
+  while (len < sizeof(line) - 1) {
+    ssize_t n = recv(fd, line + len, 1, 0);
+    if (n <= 0 || line[len] == '\n') {
+      break;
+    }
+    len++;
+  }
+  line[len] = '\0';
+
+  char *tok[4];
+  int ntok = 0;
+  char *save;
+  for (char *t = strtok_r(line, " \t\r", &save); t != NULL && ntok < 4; t = strtok_r(NULL, " \t\r", &save)) {
+    tok[ntok++] = t;
+  }
+  if (ntok >= 2 && strcmp(tok[0], "run") == 0) {
+    if (handle_run(fd, tok, ntok)) {
+      return;
+    }
+  } else if (ntok == 1 && strcmp(tok[0], "catalog") == 0) {
+    handle_catalog(fd);
+  } else {
+    send_error(fd, "expected 'run LIB [HOUSES [SCENARIOS]]' or 'catalog'");
+  }
+  close(fd);
+}
+
+static void on_signal(int sig) {
+  unlink(socketPath);
+  _exit(0);
+}
+
+static int serve(int threads) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketPath);
+  // Refuse to take over a socket another server still answers on
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    fprintf(stderr, "a server is already running on %s\n", socketPath);
+    return 1;
+  }
+  close(fd);
+  unlink(socketPath);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t mask = umask(077);
+  int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+  if (rc != 0 || listen(fd, 16) != 0) {
+    perror(socketPath);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  pool = new WorkPool(threads);
+  printf("Serving %s/*.house x %s/*.scn on %s with %d threads\n", housesDir, scenariosDir, socketPath, pool->size());
+  fflush(stdout);
+  for (;;) {
+    int client = accept(fd, NULL, NULL);
+    if (client >= 0) {
+      // Reading the request must not hold up the next client
+      std::thread(handle_client, client).detach();
+    }
+  }
+}
+
+// argv: LIB [HOUSES [SCENARIOS]]
+static int submit(int argc, char **argv) {
+  // The server resolves paths from its own directory
+  char *lib = realpath(argv[0], NULL);
+  if (lib == NULL) {
+    perror(argv[0]);
+    return 2;
+  }
+  std::string request = std::string("run ") + lib;
+  free(lib);
+  for (int i = 1; i < argc; i++) {
+    request += ' ';
+    request += argv[i];
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketPath);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    perror(socketPath);
+    return 2;
+  }
+  send_line(fd, request);
+
+  FILE *in = fdopen(fd, "r");
+  char line[4096];
+  int failed = -1;
+  while (fgets(line, sizeof(line), in) != NULL) {
+    fputs(line, stdout);
+    fflush(stdout);
+    int passed, bad, errors;
+    const char *done = strstr(line, "\"passed\":");
+    if (strncmp(line, "{\"done\"", 7) == 0 && done != NULL &&
+        sscanf(done, "\"passed\":%d,\"failed\":%d,\"errors\":%d", &passed, &bad, &errors) == 3) {
+      failed = bad + errors;
+    }
+  }
+  fclose(in);
+  return failed == 0 ? 0 : 1;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: sim_server serve [--socket PATH] [--threads N] [--houses DIR] [--scenarios DIR]\n"
+          "       sim_server submit [--socket PATH] libcontroller_sim.so [HOUSES [SCENARIOS]]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+  }
+  bool serving = strcmp(argv[1], "serve") == 0;
+  if (!serving && strcmp(argv[1], "submit") != 0) {
+    usage();
+  }
+  int threads = (int)std::thread::hardware_concurrency();
+  int i = 2;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else if (serving && strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (serving && strcmp(argv[i], "--houses") == 0 && i + 1 < argc) {
+      housesDir = argv[++i];
+    } else if (serving && strcmp(argv[i], "--scenarios") == 0 && i + 1 < argc) {
+      scenariosDir = argv[++i];
+    } else {
+      usage();
+    }
+  }
+  if (serving ? i != argc : argc - i < 1 || argc - i > 3) {
+    usage();
+  }
+  return serving ? serve(threads) : submit(argc - i, argv + i);
+}
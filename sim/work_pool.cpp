@@ -0,0 +1,100 @@
+#include "work_pool.h"
+
+WorkPool::WorkPool(int threads) : queued(0), executed(0), stolen(0), nextWorker(0), stopping(false) {
+  if (threads < 1) {
+    threads = 1;
+  }
+  for (int i = 0; i < threads; i++) {
+    workers.push_back(new Worker());
+  }
+  // Workers only start once every deque exists, as they steal from all of them
+  for (int i = 0; i < threads; i++) {
+    workers[i]->thread = std::thread(&WorkPool::run, this, i);
+  }
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> guard(idleLock);
+    stopping = true;
+  }
+  idle.notify_all();
+  for (Worker *w : workers) {
+    w->thread.join();
+    delete w;
+  }
+}
+
+void WorkPool::submit(const WorkItem *items, size_t count) {
+  {
+    std::lock_guard<std::mutex> guard(idleLock);
+    for (size_t i = 0; i < count; i++) {
+      Worker *w = workers[nextWorker];
+      nextWorker = (nextWorker + 1) % workers.size();
+      std::lock_guard<std::mutex> wg(w->lock);
+      w->jobs.push_back(items[i]);
+    }
+    queued += count;
+  }
+  idle.notify_all();
+}
+
+WorkPoolStats WorkPool::stats() const {
+  WorkPoolStats s = {executed.load(), stolen.load()};
+  return s;
+}
+
+bool WorkPool::take(int self, WorkItem *out) {
+  Worker *own = workers[self];
+  {
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->jobs.empty()) {
+      *out = own->jobs.front();
+      own->jobs.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  // Steal from the fullest deque; the sizes are a snapshot, so check again under its lock
+  Worker *victim = NULL;
+  size_t most = 0;
+  for (Worker *w : workers) {
+    if (w == own) {
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(w->lock);
+    if (w->jobs.size() > most) {
+      most = w->jobs.size();
+      victim = w;
+    }
+  }
+  if (victim == NULL) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(victim->lock);
+  if (victim->jobs.empty()) {
+    return false;
+  }
+  *out = victim->jobs.back();
+  victim->jobs.pop_back();
+  queued--;
+  stolen++;
+  return true;
+}
+
+void WorkPool::run(int self) {
+  for (;;) {
+    WorkItem item;
+    if (take(self, &item)) {
+      item.fn(item.arg);
+      executed++;
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(idleLock);
+    // A failed steal can race with another thief; only sleep when nothing is queued anywhere
+    idle.wait(guard, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
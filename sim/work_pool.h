@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for sim_server.
+//
+// Every worker has its own deque. submit() deals a batch out round-robin, so
+// the workers start without contending for one queue. A worker takes jobs
+// from the front of its own deque, in submit order. When its deque is empty
+// it steals from the back of the fullest other deque, where the shortest jobs
+// of a longest-first batch sit. House runs differ a lot in length (a one-day
+// scenario against a five-day one), and stealing keeps every core busy until
+// the batch is done. Jobs must not block.
+
+typedef void (*WorkFn)(void *arg);
+
+struct WorkItem {
+  WorkFn fn;
+  void *arg;
+};
+
+struct WorkPoolStats {
+  uint64_t executed;
+  uint64_t stolen;
+};
+
+class WorkPool {
+ public:
+  explicit WorkPool(int threads);
+  ~WorkPool();   // Finishes the queued jobs, then joins the workers
+
+  // Queues a batch. Put the longest jobs first.
+  void submit(const WorkItem *items, size_t count);
+
+  int size() const { return (int)workers.size(); }
+  WorkPoolStats stats() const;
+
+ private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<WorkItem> jobs;
+    std::thread thread;
+  };
+
+  bool take(int self, WorkItem *out);
+  void run(int self);
+
+  std::vector<Worker *> workers;
+  std::mutex idleLock;
+  std::condition_variable idle;
+  std::atomic<size_t> queued;
+  std::atomic<uint64_t> executed;
+  std::atomic<uint64_t> stolen;
+  size_t nextWorker;   // Round-robin position, under idleLock
+  bool stopping;       // Under idleLock
+};
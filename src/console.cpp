@@ -0,0 +1,190 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+#include <string.h>
+#include "console.h"
+#include "crc.h"
+#include "hal.h"
+
+struct ConsoleCommand {
+  const char *name;
+  const char *help;
+  ConsoleHandler fn;
+};
+
+static ConsoleCommand commands[CONSOLE_MAX_COMMANDS];
+static int commandCount = 0;
+
+static ConsoleTransfer lastTransfer;
+static int64_t binaryStartUs = 0;
+static uint64_t binaryStartBytes = 0;
+
+void console_register(const char *name, const char *help, ConsoleHandler fn) {
+  if (commandCount >= CONSOLE_MAX_COMMANDS) {
+    hal_printf("Console: too many commands, '%s' dropped\n", name);
+    return;
+  }
+  commands[commandCount++] = {name, help, fn};
+}
+
+static void console_help() {
+  for (int i = 0; i < commandCount; i++) {
+    hal_printf("  %-10s %s\n", commands[i].name, commands[i].help);
+  }
+}
+
+static void console_execute(char *line) {
+  char *argv[CONSOLE_MAX_ARGS];
+  int argc = 0;
+  char *save = NULL;
+  for (char *tok = strtok_r(line, " \t", &save); tok && argc < CONSOLE_MAX_ARGS;
+       tok = strtok_r(NULL, " \t", &save)) {
+    argv[argc++] = tok;
+  }
+  if (argc == 0) {
+    return;
+  }
+  if (strcmp(argv[0], "help") == 0) {
+    console_help();
+    return;
+  }
+  for (int i = 0; i < commandCount; i++) {
+    if (strcmp(argv[0], commands[i].name) == 0) {
+      commands[i].fn(argc, argv);
+      return;
+    }
+  }
+  hal_printf("Unknown command '%s', try 'help'\n", argv[0]);
+}
+
+// Console task: collects input into lines and runs the matching command
+void console_task(void *pvParameters) {
+  char line[CONSOLE_LINE_MAX];
+  int len = 0;
+  uint8_t rx[32];
+
+  while (1) {
+    size_t got = hal_console_read(rx, sizeof(rx), 1000);
+    for (size_t i = 0; i < got; i++) {
+      char c = (char)rx[i];
+      if (c == '\r' || c == '\n') {
+        if (len > 0) {
+          line[len] = '\0';
+          len = 0;
+          console_execute(line);
+        }
+      } else if (len < CONSOLE_LINE_MAX - 1) {
+        line[len++] = c;
+      }
+    }
+  }
+}
+
+void console_begin_binary() {
+  // Text still in the ring is not part of the transfer
+  hal_console_flush(1000);
+  hal_console_set_quiet(true);
+  ConsoleStats st;
+  hal_console_get_stats(&st);
+  binaryStartBytes = st.txBytes;
+  binaryStartUs = hal_micros();
+}
+
+void console_send_frame(uint8_t type, const void *payload, uint16_t len) {
+  uint8_t header[5] = {CONSOLE_SOF0, CONSOLE_SOF1, type, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+  uint16_t crc = crc16_ccitt(header + 2, 3);
+  crc = crc16_ccitt(payload, len, crc);
+  uint8_t trailer[2] = {(uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+
+  hal_console_write(header, sizeof(header));
+  hal_console_write(payload, len);
+  hal_console_write(trailer, sizeof(trailer));
+}
+
+// Reads exactly len bytes unless the deadline passes first
+static bool console_read_exact(uint8_t *buf, size_t len, int64_t deadlineUs) {
+  size_t got = 0;
+  while (got < len) {
+    int64_t leftUs = deadlineUs - hal_micros();
+    if (leftUs <= 0) {
+      return false;
+    }
+    got += hal_console_read(buf + got, len - got, (uint32_t)(leftUs / 1000) + 1);
+  }
+  return true;
+}
+
+int console_read_frame(uint8_t *type, uint8_t *payload, uint16_t maxLen, uint32_t timeoutMs) {
+  int64_t deadline = hal_micros() + (int64_t)timeoutMs * 1000;
+  // Resynchronise on the start-of-frame bytes
+  uint8_t prev = 0, c = 0;
+  do {
+    prev = c;
+    if (!console_read_exact(&c, 1, deadline)) {
+      return -1;
+    }
+  } while (prev != CONSOLE_SOF0 || c != CONSOLE_SOF1);
+
+  uint8_t header[3];
+  if (!console_read_exact(header, sizeof(header), deadline)) {
+    return -1;
+  }
+  uint16_t len = header[1] | header[2] << 8;
+  uint8_t trailer[2];
+  if (len > maxLen || !console_read_exact(payload, len, deadline) ||
+      !console_read_exact(trailer, sizeof(trailer), deadline)) {
+    return -1;
+  }
+  uint16_t crc = crc16_ccitt(payload, len, crc16_ccitt(header, sizeof(header)));
+  if (crc != (trailer[0] | trailer[1] << 8)) {
+    return -1;
+  }
+  *type = header[0];
+  return len;
+}
+
+void console_end_binary() {
+  hal_console_flush(10000);
+  ConsoleStats st;
+  hal_console_get_stats(&st);
+  lastTransfer.bytes = (uint32_t)(st.txBytes - binaryStartBytes);
+  lastTransfer.us = (uint32_t)(hal_micros() - binaryStartUs);
+  lastTransfer.baud = hal_console_baud();
+  hal_console_set_quiet(false);
+}
+
+void console_last_transfer(ConsoleTransfer *out) {
+  *out = lastTransfer;
+}
+
+// `baud` shows the link and the last transfer, `baud <rate>` switches
+static void baud_command(int argc, char **argv) {
+  if (argc >= 2) {
+    uint32_t baud = strtoul(argv[1], NULL, 10);
+    if (baud < 9600 || baud > CONSOLE_BAUD_MAX) {
+      hal_printf("Baud must be 9600..%u\n", (unsigned)CONSOLE_BAUD_MAX);
+      return;
+    }
+    // The host switches after this line; everything after it is at the new rate
+    hal_printf("Switching to %u baud\n", (unsigned)baud);
+    hal_console_set_baud(baud);
+    return;
+  }
+  ConsoleStats st;
+  hal_console_get_stats(&st);
+  uint32_t baud = hal_console_baud();
+  hal_printf("Console %u baud (8N1, wire limit %u B/s): tx %llu B, rx %llu B, %u rx overflows, tx waited %llu ms\n",
+             (unsigned)baud, (unsigned)(baud / 10), (unsigned long long)st.txBytes, (unsigned long long)st.rxBytes,
+             (unsigned)st.rxOverflows, (unsigned long long)(st.txBlockedUs / 1000));
+  if (lastTransfer.us > 0) {
+    uint32_t bps = (uint32_t)((uint64_t)lastTransfer.bytes * 1000000 / lastTransfer.us);
+    hal_printf("Last transfer: %u B in %u ms at %u baud, %u B/s (%u%% of the wire)\n", (unsigned)lastTransfer.bytes,
+               (unsigned)(lastTransfer.us / 1000), (unsigned)lastTransfer.baud, (unsigned)bps,
+               (unsigned)((uint64_t)bps * 1000 / lastTransfer.baud));
+  }
+}
+
+void console_begin() {
+  hal_console_begin(CONSOLE_BAUD);
+  console_register("baud", "Console link stats and last transfer rate; 'baud <rate>' switches", baud_command);
+}
@@ -0,0 +1,323 @@
+#include <freertos/FreeRTOS.h>
+#include <math.h>
+#include <stdlib.h>
+#include "controller.h"
+#include "hal.h"
+#include "history.h"
+#include "coord.h"
+#include "pumps.h"
+#include "kpi.h"
+#include "gains.h"
+#include "safety.h"
+
+// Shared variables (protected by mutex if needed)
+float temperature = 0.0;
+float humidity = 0.0;
+bool waterEmpty = false;
+bool valveActive = false;
+bool pumpActive = false;
+int countdown = 0;
+bool valveHasRun = false;  // Track if valve has already run for this empty cycle
+bool targetReached = false;
+PumpState pumpState = PUMP_IDLE;
+int pumpRunTime = 0;  // Run part of the current cycle, seconds
+
+static int lowVoltageCount = 0;
+static int highVoltageCount = 0;
+
+// Control log bookkeeping (see controller_tick)
+static int pendingEvent = CONTROL_START;
+static bool loggedWater = false;
+static int loggedDuty = -1;
+static uint32_t sinceLogS = 0;
+static bool safetyHeld = false;   // Latched safety fault already handled
+
+void controller_begin() {
+  // Initialize valve pin
+  hal_gpio_output(VALVE_PIN, LOW);
+  hal_printf("Valve initialized on GPIO%d\n", VALVE_PIN);
+
+  // Initialize pump PWM channels (stopped initially) and their wear counters
+  pumps_begin();
+  kpi_begin(pumps_total_starts());
+  gains_begin();
+}
+
+void controller_reading(float temp, float hum) {
+  if (!isnan(temp) && !isnan(hum)) {
+    temperature = temp;
+    humidity = hum + HUMIDITY_OFFSET;
+  }
+}
+
+void controller_level(int voltage) {
+  if (voltage == HIGH) {
+    // High voltage detected - water empty
+    lowVoltageCount++;
+    highVoltageCount = 0;  // Reset high voltage counter
+
+    if (lowVoltageCount >= DEBOUNCE_COUNT && !waterEmpty) {
+      waterEmpty = true;
+      hal_printf("WATER EMPTY detected!\n");
+    }
+  } else {
+    // Low voltage detected - water OK
+    highVoltageCount++;
+    lowVoltageCount = 0;  // Reset low voltage counter
+
+    if (highVoltageCount >= DEBOUNCE_COUNT && waterEmpty) {
+      waterEmpty = false;
+      hal_printf("Water level OK\n");
+    }
+  }
+}
+
+// Humidity target check, once per control tick. When coordinated over RS-485
+// the master decides from the house average and says so in every poll; the
+// duty is no guide, since an empty or refilling unit gets none either.
+// Standalone, pumping resumes only once humidity has dropped the scheduled
+// hysteresis below the preset.
+static bool target_reached(const GainSet &gains) {
+  if (coord_pump_duty() >= 0) {
+    return coord_at_target();
+  }
+  if (humidity >= HUMIDITY_PRESET) {
+    return true;
+  }
+  return targetReached && humidity > HUMIDITY_PRESET - gains.hysteresis / 10.0;
+}
+
+// Standalone pump duty: scheduled base duty plus proportional term on the deficit
+static int standalone_duty(const GainSet &gains) {
+  float deficit = HUMIDITY_PRESET - humidity;
+  int duty = gains.baseDuty + (int)(gains.kp * (deficit > 0 ? deficit : 0));
+  return duty < 100 ? duty : 100;
+}
+
+// Current controller state as a control log record (see HistoryControl)
+static void control_log(uint8_t event, int duty) {
+  HistoryRecord rec = {};
+  rec.type = HISTORY_CONTROL;
+  HistoryControl &c = rec.control;
+  c.event = event;
+  c.pumpState = pumpState;
+  c.pumps = pumps_running();
+  c.bits = (valveActive ? CONTROL_BIT_VALVE : 0) | (valveHasRun ? CONTROL_BIT_VALVE_HAS_RUN : 0) |
+           (targetReached ? CONTROL_BIT_TARGET : 0) | (waterEmpty ? CONTROL_BIT_WATER_EMPTY : 0) |
+           (pumpActive ? CONTROL_BIT_PUMP : 0);
+  c.countdown = countdown;
+  c.pumpRunTime = pumpRunTime;
+  c.humidity = (int16_t)lroundf(humidity * 10);
+  c.duty = (int8_t)duty;
+  c.loadQ16 = gains_load_q16();
+  history_append(&rec);
+}
+
+// One control tick's decisions, in priority order. Returns the
+// ControlEventCode of the decision taken, or -1 if the state only counted down.
+static int control_decide(const GainSet &gains, int seconds) {
+  // Priority 1: If humidity >= preset, stop everything
+  if (targetReached) {
+    int event = -1;
+    if (valveActive) {
+      hal_gpio_write(VALVE_PIN, LOW);
+      valveActive = false;
+      countdown = 0;
+      event = CONTROL_TARGET;
+      hal_printf("Valve stopped - humidity reached preset\n");
+    }
+    if (pumpActive) {
+      pumps_stop_all();
+      pumpActive = false;
+      countdown = 0;
+      pumpState = PUMP_IDLE;
+      event = CONTROL_TARGET;
+      hal_printf("Pump stopped - humidity reached preset\n");
+    }
+    return event;
+  }
+
+  // Priority 2: Valve is active - let it complete regardless of waterEmpty status
+  if (valveActive) {
+    int event = -1;
+    // Stop pump if running
+    if (pumpActive) {
+      pumps_stop_all();
+      pumpActive = false;
+      pumpState = PUMP_IDLE;
+      event = CONTROL_PUMP_ABORT;
+      hal_printf("Pump stopped - valve active\n");
+    }
+
+    // Continue valve countdown
+    if (countdown > 0) {
+      countdown = countdown > seconds ? countdown - seconds : 0;
+    } else {
+      hal_gpio_write(VALVE_PIN, LOW);
+      valveActive = false;
+      valveHasRun = true;
+      event = CONTROL_VALVE_STOP;
+      hal_printf("Valve stopped after countdown complete\n");
+    }
+    return event;  // Skip all other logic while valve is active
+  }
+
+  // Priority 3: Water is empty and valve not active - start valve
+  if (waterEmpty && !valveHasRun) {
+    // Stop pump immediately if running
+    if (pumpActive) {
+      pumps_stop_all();
+      pumpActive = false;
+      countdown = 0;
+      pumpState = PUMP_IDLE;
+      hal_printf("Pump stopped - water empty\n");
+    }
+
+    // Start valve
+    hal_gpio_write(VALVE_PIN, HIGH);
+    valveActive = true;
+    countdown = VALVE_FILL_S;
+    hal_printf("Valve started - filling water for %ds\n", VALVE_FILL_S);
+    return CONTROL_VALVE_START;
+  }
+
+  // Priority 4: Water is OK - reset valve flag and run pump cycles
+  int event = -1;
+  if (!waterEmpty && valveHasRun) {
+    valveHasRun = false;  // Reset flag when water is OK
+    event = CONTROL_WATER;
+  }
+
+  // Pump state machine - only runs when water is OK, humidity < preset, and valve is not active
+  if (!waterEmpty && !valveActive) {
+    switch (pumpState) {
+      case PUMP_IDLE: {
+        // Start pump cycle; the run share of the cycle follows the duty
+        int duty = coord_pump_duty();
+        if (duty < 0) {
+          duty = standalone_duty(gains);
+        }
+        if (duty == 0) {
+          return -1;   // Nothing to run, e.g. no share from the coordinator this round
+        }
+        // Lag pumps join only when one pump cannot keep up: a large local
+        // deficit, or full duty from the coordinator
+        int count = coord_pump_duty() >= 100 ? PUMP_CHANNELS
+                                             : pumps_needed(HUMIDITY_PRESET - humidity, gains.lagDeficit);
+        pumps_start(count);
+        pumpActive = true;
+        pumpRunTime = PUMP_CYCLE_S * duty / 100;
+        countdown = pumpRunTime;
+        pumpState = PUMP_RUNNING;
+        hal_printf("%d pump(s) started for %ds at 85%%\n", count, countdown);
+        return CONTROL_PUMP_START;
+      }
+
+      case PUMP_RUNNING:
+        if (countdown > 0) {
+          countdown = countdown > seconds ? countdown - seconds : 0;
+        } else {
+          // Pump cycle complete, stop pump
+          pumps_stop_all();
+          pumpActive = false;
+          countdown = PUMP_CYCLE_S - pumpRunTime;
+          pumpState = PUMP_WAITING;
+          hal_printf("Pump stopped, waiting %ds\n", countdown);
+          return CONTROL_PUMP_STOP;
+        }
+        break;
+
+      case PUMP_WAITING:
+        if (countdown > 0) {
+          countdown = countdown > seconds ? countdown - seconds : 0;
+        } else {
+          // Wait complete, restart cycle
+          pumpState = PUMP_IDLE;
+          return CONTROL_WAIT_DONE;
+        }
+        break;
+    }
+  } else {
+    // Water empty or valve active - stop pump if running
+    if (pumpActive) {
+      pumps_stop_all();
+      pumpActive = false;
+      pumpState = PUMP_IDLE;
+      return CONTROL_PUMP_ABORT;
+    }
+  }
+  return event;
+}
+
+// The supervisor has already forced the outputs off; bring the state in line
+// with them once and stay idle until the latch is cleared. A `safety test`
+// trip is held the same way, so no valve or pump cycle counts down with the
+// output actually off, but it is not a fault and is not logged.
+static int safety_hold() {
+  if (safetyHeld) {
+    return -1;
+  }
+  safetyHeld = true;
+  pumps_stop_all();
+  hal_gpio_write(VALVE_PIN, LOW);
+  pumpActive = false;
+  valveActive = false;
+  valveHasRun = false;
+  pumpState = PUMP_IDLE;
+  countdown = 0;
+  if (!safety_latched()) {
+    return -1;
+  }
+  SafetyStats st;
+  safety_get_stats(&st);
+  SafetyFault f = safety_fault();
+  hal_printf("SAFETY FAULT: %s, outputs off\n", safety_fault_name(f));
+  history_log_event(EVENT_SAFETY, f, (int32_t)st.lastReactionUs, "safety");
+  return CONTROL_SAFETY;
+}
+
+// Every decision, input change and a periodic snapshot go to the history log
+// as HISTORY_CONTROL records, so the state at any past moment can be rebuilt
+// with tools/history_replay.py.
+void controller_tick(int seconds) {
+  CoordStatus local = {(int16_t)lroundf(humidity * 10), waterEmpty, valveActive, pumps_total_runtime() / 60};
+  coord_set_local(&local);
+  for (int s = 0; s < seconds; s++) {
+    kpi_tick(local.humidity, (int16_t)lroundf(HUMIDITY_PRESET * 10), pumps_running(), pumps_total_starts());
+    gains_tick(pumps_running() > 0);
+  }
+  GainSet gains;
+  gains_current(&gains);
+  bool wasTarget = targetReached;
+  targetReached = target_reached(gains);
+
+  int decided;
+  if (safety_outputs_held()) {
+    decided = safety_hold();
+  } else {
+    safetyHeld = false;
+    decided = control_decide(gains, seconds);
+  }
+  int duty = coord_pump_duty();
+  sinceLogS += seconds;
+  if (decided >= 0) {
+    pendingEvent = decided;
+  } else if (pendingEvent < 0) {
+    if (targetReached != wasTarget) {
+      pendingEvent = CONTROL_TARGET;
+    } else if (waterEmpty != loggedWater) {
+      pendingEvent = CONTROL_WATER;
+    } else if (abs(duty - loggedDuty) >= CONTROL_DUTY_STEP || (duty < 0) != (loggedDuty < 0)) {
+      pendingEvent = CONTROL_DUTY;
+    } else if (sinceLogS >= CONTROL_SNAPSHOT_S) {
+      pendingEvent = CONTROL_SNAPSHOT;
+    }
+  }
+  if (pendingEvent >= 0) {
+    control_log(pendingEvent, duty);
+    pendingEvent = -1;
+    loggedWater = waterEmpty;
+    loggedDuty = duty;
+    sinceLogS = 0;
+  }
+}
@@ -0,0 +1,222 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+#include "coord.h"
+#include "console.h"
+#include "crc.h"
+#include "gains.h"
+#include "hal.h"
+
+#define COORD_SOF0 0xA5
+#define COORD_SOF1 0x5A
+#define COORD_MAX_PAYLOAD 32
+
+enum CoordFrameType : uint8_t {
+  COORD_POLL = 0x01,    // master -> slave, payload: CoordPoll
+  COORD_STATUS = 0x02,  // slave -> master, payload: CoordStatus
+};
+
+struct CoordFrame {
+  uint8_t dst, src, type, len;
+  uint8_t payload[COORD_MAX_PAYLOAD];
+};
+
+static uint8_t unitId = 0;
+static int16_t presetX10 = 0;
+static portMUX_TYPE coordMux = portMUX_INITIALIZER_UNLOCKED;
+static CoordStatus local;
+static volatile int assignedDuty = -1;
+static volatile bool atTarget = false;
+static volatile uint32_t lastPollMs = 0;
+static CoordUnit units[COORD_MAX_UNITS];  // Master only, index = id - 1
+
+// Receive side: byte-at-a-time parser, resyncs on the start bytes
+static uint8_t rxBuf[6 + COORD_MAX_PAYLOAD];
+static int rxLen = 0;
+
+static void coord_send(uint8_t dst, uint8_t type, const void *payload, uint8_t len) {
+  uint8_t buf[8 + COORD_MAX_PAYLOAD];
+  buf[0] = COORD_SOF0;
+  buf[1] = COORD_SOF1;
+  buf[2] = dst;
+  buf[3] = unitId;
+  buf[4] = type;
+  buf[5] = len;
+  memcpy(buf + 6, payload, len);
+  uint16_t crc = crc16_ccitt(buf + 2, 4 + len);
+  buf[6 + len] = crc & 0xFF;
+  buf[7 + len] = crc >> 8;
+
+  hal_gpio_write(COORD_DE_PIN, HIGH);
+  hal_uart_write(COORD_UART, buf, 8 + len);
+  hal_gpio_write(COORD_DE_PIN, LOW);
+}
+
+// Returns true when a complete, valid frame is in *out
+static bool coord_parse(uint8_t c, CoordFrame *out) {
+  if (rxLen == 0 && c != COORD_SOF0) {
+    return false;
+  }
+  if (rxLen == 1 && c != COORD_SOF1) {
+    rxLen = (c == COORD_SOF0) ? 1 : 0;
+    return false;
+  }
+  rxBuf[rxLen++] = c;
+  if (rxLen >= 6 && rxBuf[5] > COORD_MAX_PAYLOAD) {
+    rxLen = 0;
+    return false;
+  }
+  if (rxLen < 6 || rxLen < 8 + rxBuf[5]) {
+    return false;
+  }
+
+  int len = rxBuf[5];
+  rxLen = 0;
+  uint16_t crc = crc16_ccitt(rxBuf + 2, 4 + len);
+  if ((rxBuf[6 + len] | (rxBuf[7 + len] << 8)) != crc) {
+    return false;
+  }
+  out->dst = rxBuf[2];
+  out->src = rxBuf[3];
+  out->type = rxBuf[4];
+  out->len = len;
+  memcpy(out->payload, rxBuf + 6, len);
+  return true;
+}
+
+// Waits up to timeoutMs for a frame addressed to this unit
+static bool coord_receive(CoordFrame *frame, uint32_t timeoutMs) {
+  uint32_t start = hal_millis();
+  uint8_t buf[32];
+  while (true) {
+    uint32_t elapsed = hal_millis() - start;
+    if (elapsed >= timeoutMs) {
+      return false;
+    }
+    size_t got = hal_uart_read(COORD_UART, buf, sizeof(buf), timeoutMs - elapsed);
+    for (size_t i = 0; i < got; i++) {
+      if (coord_parse(buf[i], frame) && frame->dst == unitId) {
+        // Anything after the frame belongs to the next exchange
+        return true;
+      }
+    }
+  }
+}
+
+void coord_set_local(const CoordStatus *status) {
+  portENTER_CRITICAL(&coordMux);
+  local = *status;
+  portEXIT_CRITICAL(&coordMux);
+}
+
+int coord_pump_duty() {
+  if (unitId == COORD_MASTER_ID) {
+    return assignedDuty;
+  }
+  if (unitId == 0 || lastPollMs == 0 || hal_millis() - lastPollMs > COORD_TIMEOUT_MS) {
+    return -1;
+  }
+  return assignedDuty;
+}
+
+bool coord_at_target() {
+  return atTarget;
+}
+
+void coord_master_round() {
+  static uint8_t duty[COORD_MAX_UNITS];
+  static bool houseAtTarget = false;
+
+  portENTER_CRITICAL(&coordMux);
+  units[0].status = local;
+  portEXIT_CRITICAL(&coordMux);
+  units[0].online = true;
+
+  for (int id = 2; id <= COORD_MAX_UNITS; id++) {
+    CoordUnit &u = units[id - 1];
+    CoordPoll poll = {duty[id - 1], houseAtTarget};
+    coord_send(id, COORD_POLL, &poll, sizeof(poll));
+    CoordFrame reply;
+    if (coord_receive(&reply, COORD_REPLY_MS) && reply.src == id && reply.type == COORD_STATUS &&
+        reply.len == sizeof(CoordStatus)) {
+      memcpy(&u.status, reply.payload, sizeof(CoordStatus));
+      u.online = true;
+      u.misses = 0;
+    } else if (u.misses < COORD_MAX_MISSES) {
+      u.misses++;
+    } else {
+      u.online = false;
+    }
+  }
+
+  GainSet gains;
+  gains_current(&gains);
+  houseAtTarget = coord_assign(units, COORD_MAX_UNITS, presetX10, gains.hysteresis, houseAtTarget, duty);
+  atTarget = houseAtTarget;
+  assignedDuty = duty[0];
+}
+
+void coord_slave_poll() {
+  CoordFrame frame;
+  if (!coord_receive(&frame, 500)) {
+    return;
+  }
+  if (frame.type != COORD_POLL || frame.src != COORD_MASTER_ID || frame.len != sizeof(CoordPoll)) {
+    return;
+  }
+  CoordPoll poll;
+  memcpy(&poll, frame.payload, sizeof(poll));
+  atTarget = poll.atTarget != 0;
+  assignedDuty = poll.duty;
+  lastPollMs = hal_millis();
+
+  CoordStatus status;
+  portENTER_CRITICAL(&coordMux);
+  status = local;
+  portEXIT_CRITICAL(&coordMux);
+  coord_send(COORD_MASTER_ID, COORD_STATUS, &status, sizeof(status));
+}
+
+// Coordination task, only started when COORD_UNIT_ID != 0
+void coord_task(void *pvParameters) {
+  TickType_t lastWake = xTaskGetTickCount();
+  while (1) {
+    if (unitId == COORD_MASTER_ID) {
+      coord_master_round();
+      vTaskDelayUntil(&lastWake, COORD_PERIOD_MS / portTICK_PERIOD_MS);
+    } else {
+      coord_slave_poll();
+    }
+  }
+}
+
+static void coord_command(int argc, char **argv) {
+  if (unitId == 0) {
+    hal_printf("Coordination off (standalone)\n");
+    return;
+  }
+  hal_printf("Unit %u (%s), duty %d%%%s\n", unitId, unitId == COORD_MASTER_ID ? "master" : "slave",
+             coord_pump_duty(), atTarget ? ", house at preset" : "");
+  if (unitId != COORD_MASTER_ID) {
+    hal_printf("Last poll %u ms ago\n", (unsigned)(hal_millis() - lastPollMs));
+    return;
+  }
+  for (int i = 0; i < COORD_MAX_UNITS; i++) {
+    const CoordUnit &u = units[i];
+    hal_printf("  #%d %-7s hum %.1f%% water %s%s runtime %uh\n", i + 1, u.online ? "online" : "offline",
+               u.status.humidity / 10.0, u.status.waterEmpty ? "EMPTY" : "OK", u.status.filling ? " (filling)" : "",
+               (unsigned)(u.status.runtimeMin / 60));
+  }
+}
+
+void coord_begin(uint8_t id, int16_t preset) {
+  unitId = id;
+  presetX10 = preset;
+  console_register("coord", "Show RS-485 coordination state", coord_command);
+  if (unitId == 0) {
+    return;
+  }
+  hal_gpio_output(COORD_DE_PIN, LOW);
+  hal_uart_begin(COORD_UART, COORD_TX_PIN, COORD_RX_PIN, COORD_BAUD);
+  hal_printf("RS-485 coordination: unit %u (%s)\n", unitId, unitId == COORD_MASTER_ID ? "master" : "slave");
+}
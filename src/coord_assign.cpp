@@ -0,0 +1,71 @@
+#include "coord.h"
+
+// Kept apart from the bus code so the host simulator can link it
+bool coord_assign(const CoordUnit *units, int n, int16_t preset, int16_t hysteresis, bool atTarget,
+                  uint8_t *duty) {
+  int32_t sum = 0;
+  int valid = 0;
+  uint32_t maxRuntime = 0;
+  bool eligible[COORD_MAX_UNITS] = {};
+
+  for (int i = 0; i < n; i++) {
+    duty[i] = 0;
+    if (!units[i].online) {
+      continue;
+    }
+    if (units[i].status.humidity > 0) {
+      sum += units[i].status.humidity;
+      valid++;
+    }
+    eligible[i] = !units[i].status.waterEmpty && !units[i].status.filling;
+    if (eligible[i] && units[i].status.runtimeMin > maxRuntime) {
+      maxRuntime = units[i].status.runtimeMin;
+    }
+  }
+  if (valid == 0) {
+    return true;   // Nothing to go on: hold rather than pump blind
+  }
+  int32_t deficit = preset - sum / valid;  // 0.1 %RH
+  if (deficit <= 0 || (atTarget && deficit < hysteresis)) {
+    return true;
+  }
+  int32_t left = deficit * COORD_GAIN_PCT / 10;
+
+  // Water-fill: share out by weight, cap at 100 %, hand the overflow to the rest
+  uint32_t weight[COORD_MAX_UNITS];
+  bool capped[COORD_MAX_UNITS] = {};
+  for (int i = 0; i < n; i++) {
+    weight[i] = eligible[i] ? maxRuntime - units[i].status.runtimeMin + COORD_RUNTIME_BIAS_MIN : 0;
+  }
+  for (int pass = 0; pass < n && left > 0; pass++) {
+    uint64_t weightSum = 0;
+    for (int i = 0; i < n; i++) {
+      if (eligible[i] && !capped[i]) {
+        weightSum += weight[i];
+      }
+    }
+    if (weightSum == 0) {
+      break;
+    }
+    int32_t given = 0;
+    bool anyCapped = false;
+    for (int i = 0; i < n; i++) {
+      if (!eligible[i] || capped[i]) {
+        continue;
+      }
+      int32_t share = (int32_t)((uint64_t)left * weight[i] / weightSum);
+      if (duty[i] + share >= 100) {
+        share = 100 - duty[i];
+        capped[i] = true;
+        anyCapped = true;
+      }
+      duty[i] += share;
+      given += share;
+    }
+    left -= given;
+    if (!anyCapped) {
+      break;  // Only rounding remainder left
+    }
+  }
+  return false;
+}
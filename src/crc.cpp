@@ -0,0 +1,24 @@
+#include "crc.h"
+
+uint16_t crc16_ccitt(const void *data, size_t len, uint16_t crc) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (len--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint8_t crc8_sensor(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint8_t crc = 0xFF;
+  while (len--) {
+    crc ^= *p++;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,127 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display.h"
+#include "font5x7.h"
+
+Display::Display(DisplayPanel *p) : panel(p), w(p->width()), h(p->height()) {}
+
+Display::~Display() {
+  free(buffer);
+  free(shadow);
+}
+
+bool Display::begin() {
+  size_t size = w * ((h + 7) / 8);
+  if (buffer == nullptr) {
+    buffer = (uint8_t *)malloc(size);
+    shadow = (uint8_t *)malloc(size);
+    if (buffer == nullptr || shadow == nullptr) {
+      return false;
+    }
+  }
+  clearDisplay();
+  forceFull = true;
+  return panel->begin();
+}
+
+bool Display::findDirty(DisplayDirty *dirty) {
+  bool any = false;
+  dirty->pages = (h + 7) / 8;
+  for (int p = 0; p < dirty->pages; p++) {
+    const uint8_t *now = buffer + p * w;
+    const uint8_t *was = shadow + p * w;
+    int x0 = 0, x1 = w - 1;
+    if (!forceFull) {
+      while (x0 < w && now[x0] == was[x0]) {
+        x0++;
+      }
+      while (x1 > x0 && now[x1] == was[x1]) {
+        x1--;
+      }
+    }
+    if (x0 < w) {
+      memcpy(shadow + p * w + x0, now + x0, x1 - x0 + 1);
+      any = true;
+    } else {
+      x1 = -1;
+    }
+    dirty->x0[p] = x0;
+    dirty->x1[p] = x1;
+  }
+  forceFull = false;
+  return any;
+}
+
+void Display::display() {
+  DisplayDirty dirty;
+  if (buffer == nullptr || !findDirty(&dirty)) {
+    return;
+  }
+  panel->flush(buffer, dirty);
+  frameCount++;
+}
+
+void Display::clearDisplay() {
+  if (buffer != nullptr) {
+    memset(buffer, 0, w * ((h + 7) / 8));
+  }
+}
+
+void Display::drawPixel(int x, int y, int color) {
+  if (buffer == nullptr || x < 0 || y < 0 || x >= w || y >= h) {
+    return;
+  }
+  uint8_t *p = &buffer[x + (y / 8) * w];
+  if (color) {
+    *p |= (1 << (y & 7));
+  } else {
+    *p &= ~(1 << (y & 7));
+  }
+}
+
+void Display::drawChar(int x, int y, char c) {
+  if (c < FONT5X7_FIRST || c >= FONT5X7_FIRST + FONT5X7_COUNT) {
+    c = '?';
+  }
+  const uint8_t *glyph = font5x7[c - FONT5X7_FIRST];
+  for (int col = 0; col < FONT5X7_WIDTH; col++) {
+    uint8_t bits = glyph[col];
+    for (int row = 0; row < 8; row++) {
+      if (bits & (1 << row)) {
+        for (int sx = 0; sx < textSize; sx++) {
+          for (int sy = 0; sy < textSize; sy++) {
+            drawPixel(x + col * textSize + sx, y + row * textSize + sy, textColor);
+          }
+        }
+      }
+    }
+  }
+}
+
+void Display::print(const char *s) {
+  for (; *s; s++) {
+    if (*s == '\n') {
+      cursorX = 0;
+      cursorY += 8 * textSize;
+    } else if (*s != '\r') {
+      drawChar(cursorX, cursorY, *s);
+      cursorX += 6 * textSize;  // 5 px glyph + 1 px spacing
+    }
+  }
+}
+
+void Display::println(const char *s) {
+  print(s);
+  print("\n");
+}
+
+void Display::printf(const char *fmt, ...) {
+  char buf[64];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  print(buf);
+}
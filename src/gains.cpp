@@ -0,0 +1,99 @@
+#include <freertos/FreeRTOS.h>
+#include <nvs.h>
+#include "gains.h"
+#include "console.h"
+#include "hal.h"
+
+#define GAINS_NVS_NAMESPACE "gains"
+#define GAINS_NVS_KEY "load"
+
+static const GainSet gainTable[GAIN_POINTS] = GAIN_TABLE;
+
+// Learned load in permille, Q16 fixed point so the slow average keeps its precision
+static volatile uint32_t loadQ16 = 0;
+static uint32_t ticksSinceSave = 0;
+
+static uint8_t lerp_u8(uint8_t a, uint8_t b, int32_t num, int32_t den) {
+  return (uint8_t)(a + ((int32_t)b - a) * num / den);
+}
+
+void gains_interpolate(const GainSet *table, int n, int16_t load, GainSet *out) {
+  if (load <= table[0].load) {
+    *out = table[0];
+    return;
+  }
+  for (int i = 1; i < n; i++) {
+    if (load <= table[i].load) {
+      const GainSet &a = table[i - 1];
+      const GainSet &b = table[i];
+      int32_t num = load - a.load;
+      int32_t den = b.load - a.load;
+      out->load = load;
+      out->baseDuty = lerp_u8(a.baseDuty, b.baseDuty, num, den);
+      out->kp = lerp_u8(a.kp, b.kp, num, den);
+      out->hysteresis = lerp_u8(a.hysteresis, b.hysteresis, num, den);
+      out->lagDeficit = lerp_u8(a.lagDeficit, b.lagDeficit, num, den);
+      return;
+    }
+  }
+  *out = table[n - 1];
+}
+
+static void gains_save() {
+  nvs_handle_t nvs;
+  if (nvs_open(GAINS_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  nvs_set_u32(nvs, GAINS_NVS_KEY, loadQ16);
+  nvs_commit(nvs);
+  nvs_close(nvs);
+}
+
+void gains_tick(bool pumping) {
+  int32_t target = pumping ? (1000 << 16) : 0;
+  loadQ16 = (uint32_t)((int32_t)loadQ16 + (target - (int32_t)loadQ16) / GAIN_LOAD_TAU_S);
+  if (++ticksSinceSave >= GAIN_SAVE_PERIOD_S) {
+    ticksSinceSave = 0;
+    gains_save();
+  }
+}
+
+int16_t gains_load() {
+  return (int16_t)(loadQ16 >> 16);
+}
+
+uint32_t gains_load_q16() {
+  return loadQ16;
+}
+
+void gains_current(GainSet *out) {
+  gains_interpolate(gainTable, GAIN_POINTS, gains_load(), out);
+}
+
+static void gains_command(int argc, char **argv) {
+  GainSet g;
+  gains_current(&g);
+  hal_printf("Learned load %d.%d%%: base duty %u%%, kp %u%%/%%RH, hysteresis %u.%u%%, lag pump every %u%%RH\n",
+             gains_load() / 10, gains_load() % 10, g.baseDuty, g.kp, g.hysteresis / 10, g.hysteresis % 10,
+             g.lagDeficit);
+  for (int i = 0; i < GAIN_POINTS; i++) {
+    const GainSet &t = gainTable[i];
+    hal_printf("  @%d.%d%%: %u%% + %u%%/%%RH, hyst %u.%u%%, lag %u%%RH\n", t.load / 10, t.load % 10, t.baseDuty,
+               t.kp, t.hysteresis / 10, t.hysteresis % 10, t.lagDeficit);
+  }
+}
+
+void gains_begin() {
+  nvs_handle_t nvs;
+  if (nvs_open(GAINS_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+    uint32_t saved;
+    if (nvs_get_u32(nvs, GAINS_NVS_KEY, &saved) == ESP_OK && saved <= (1000u << 16)) {
+      loadQ16 = saved;
+    }
+    nvs_close(nvs);
+  } else {
+    // First boot: start mid-table rather than assuming no load
+    loadQ16 = (uint32_t)gainTable[GAIN_POINTS / 2].load << 16;
+  }
+  console_register("gains", "Show learned load and the scheduled controller gains", gains_command);
+}
@@ -0,0 +1,137 @@
+// Arduino core backend (env:esp32dev)
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <driver/gpio.h>
+#include "hal.h"
+
+// The console is in hal_console.cpp; Serial is never started so UART0
+// belongs to the IDF driver
+
+static HardwareSerial *hal_uart(int port) {
+  return port == 1 ? &Serial1 : &Serial2;
+}
+
+bool hal_uart_begin(int port, int txPin, int rxPin, uint32_t baud) {
+  hal_uart(port)->begin(baud, SERIAL_8N1, rxPin, txPin);
+  return true;
+}
+
+void hal_uart_write(int port, const void *data, size_t len) {
+  HardwareSerial *uart = hal_uart(port);
+  uart->write((const uint8_t *)data, len);
+  uart->flush();
+}
+
+size_t hal_uart_read(int port, uint8_t *data, size_t maxLen, uint32_t timeoutMs) {
+  HardwareSerial *uart = hal_uart(port);
+  uint32_t start = millis();
+  while (!uart->available()) {
+    if (millis() - start >= timeoutMs) {
+      return 0;
+    }
+    vTaskDelay(1);
+  }
+  return uart->read(data, maxLen);
+}
+
+uint32_t hal_millis() {
+  return millis();
+}
+
+int64_t hal_micros() {
+  return esp_timer_get_time();
+}
+
+void hal_delay_ms(uint32_t ms) {
+  delay(ms);
+}
+
+void hal_gpio_input(int pin) {
+  pinMode(pin, INPUT);
+}
+
+void hal_gpio_output(int pin, int level) {
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, level);
+  // Keep the input buffer on so hal_gpio_read() returns the actual pin level
+  gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT);
+}
+
+void hal_gpio_write(int pin, int level) {
+  digitalWrite(pin, level);
+}
+
+int hal_gpio_read(int pin) {
+  return digitalRead(pin);
+}
+
+void hal_pwm_init(int pin, int channel, uint32_t freq, int resolutionBits) {
+  ledcSetup(channel, freq, resolutionBits);
+  ledcAttachPin(pin, channel);
+  ledcWrite(channel, 0);
+}
+
+void hal_pwm_write(int channel, uint32_t duty) {
+  ledcWrite(channel, duty);
+}
+
+uint32_t hal_pwm_read(int channel) {
+  return ledcRead(channel);
+}
+
+bool hal_i2c_begin(int sda, int scl, uint32_t hz) {
+  return Wire.begin(sda, scl, hz);
+}
+
+bool hal_i2c_probe(uint8_t addr) {
+  int64_t start = hal_micros();
+  Wire.beginTransmission(addr);
+  bool ok = Wire.endTransmission() == 0;
+  hal_i2c_account(start, 0, ok);
+  return ok;
+}
+
+bool hal_i2c_write(uint8_t addr, const uint8_t *data, size_t len) {
+  int64_t start = hal_micros();
+  Wire.beginTransmission(addr);
+  size_t written = Wire.write(data, len);
+  bool ok = Wire.endTransmission() == 0 && written == len;
+  hal_i2c_account(start, len, ok);
+  return ok;
+}
+
+bool hal_i2c_read(uint8_t addr, uint8_t *data, size_t len) {
+  int64_t start = hal_micros();
+  size_t got = Wire.requestFrom((uint16_t)addr, len, true);
+  for (size_t i = 0; i < got && i < len; i++) {
+    data[i] = Wire.read();
+  }
+  bool ok = got == len;
+  hal_i2c_account(start, len, ok);
+  return ok;
+}
+
+static SPISettings spiSettings;
+static int spiCs = -1;
+
+bool hal_spi_begin(int sckPin, int mosiPin, int csPin, uint32_t hz) {
+  spiSettings = SPISettings(hz, MSBFIRST, SPI_MODE0);
+  spiCs = csPin;
+  pinMode(spiCs, OUTPUT);
+  digitalWrite(spiCs, HIGH);
+  SPI.begin(sckPin, -1, mosiPin, -1);
+  return true;
+}
+
+void hal_spi_write(const void *data, size_t len) {
+  SPI.beginTransaction(spiSettings);
+  digitalWrite(spiCs, LOW);
+  SPI.writeBytes((const uint8_t *)data, len);
+  digitalWrite(spiCs, HIGH);
+  SPI.endTransaction();
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,56 @@
+#include <freertos/FreeRTOS.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+
+static volatile bool consoleQuiet = false;
+
+void hal_console_set_quiet(bool quiet) {
+  consoleQuiet = quiet;
+}
+
+void hal_printf(const char *fmt, ...) {
+  if (consoleQuiet) {
+    return;
+  }
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (len > 0) {
+    hal_console_write(buf, len < (int)sizeof(buf) ? len : sizeof(buf) - 1);
+  }
+}
+
+// I2C statistics are updated from tasks on both cores
+static I2cStats i2cStats;
+static portMUX_TYPE i2cStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void hal_i2c_account(int64_t startUs, size_t bytes, bool ok) {
+  uint32_t elapsed = (uint32_t)(hal_micros() - startUs);
+  portENTER_CRITICAL(&i2cStatsMux);
+  i2cStats.transactions++;
+  if (!ok) {
+    i2cStats.errors++;
+  }
+  i2cStats.bytes += bytes;
+  i2cStats.busyUs += elapsed;
+  if (elapsed > i2cStats.maxUs) {
+    i2cStats.maxUs = elapsed;
+  }
+  portEXIT_CRITICAL(&i2cStatsMux);
+}
+
+void hal_i2c_get_stats(I2cStats *out) {
+  portENTER_CRITICAL(&i2cStatsMux);
+  *out = i2cStats;
+  portEXIT_CRITICAL(&i2cStatsMux);
+}
+
+void hal_i2c_reset_stats() {
+  portENTER_CRITICAL(&i2cStatsMux);
+  memset(&i2cStats, 0, sizeof(i2cStats));
+  portEXIT_CRITICAL(&i2cStatsMux);
+}
@@ -0,0 +1,112 @@
+// Console UART for both builds. The Arduino core ships the same IDF UART
+// driver, and Serial is never started, so this file owns UART0 either way.
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <driver/uart.h>
+#include <esp_idf_version.h>
+#include "hal.h"
+
+#define CONSOLE_UART UART_NUM_0
+#define CONSOLE_BAUD_MIN 9600
+
+static QueueHandle_t consoleEvents = NULL;
+static uint32_t consoleBaud = CONSOLE_BAUD;
+static ConsoleStats consoleStats;
+static portMUX_TYPE consoleStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void hal_console_begin(uint32_t baud) {
+  uart_config_t cfg = {};
+  cfg.baud_rate = (int)baud;
+  cfg.data_bits = UART_DATA_8_BITS;
+  cfg.parity = UART_PARITY_DISABLE;
+  cfg.stop_bits = UART_STOP_BITS_1;
+  cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+#if ESP_IDF_VERSION_MAJOR >= 5
+  cfg.source_clk = UART_SCLK_DEFAULT;
+#else
+  cfg.source_clk = UART_SCLK_APB;
+#endif
+  uart_driver_install(CONSOLE_UART, CONSOLE_RX_BUF, CONSOLE_TX_BUF, CONSOLE_EVENT_QUEUE, &consoleEvents, 0);
+  uart_param_config(CONSOLE_UART, &cfg);
+  consoleBaud = baud;
+}
+
+void hal_console_write(const void *data, size_t len) {
+  // Chunks keep each copy short, so the TX interrupt refills the FIFO from
+  // the ring while the rest of a large frame is still being copied in
+  const uint8_t *p = (const uint8_t *)data;
+  int64_t blockedUs = 0;
+  for (size_t off = 0; off < len; off += CONSOLE_TX_CHUNK) {
+    size_t n = len - off < CONSOLE_TX_CHUNK ? len - off : CONSOLE_TX_CHUNK;
+    int64_t start = hal_micros();
+    uart_write_bytes(CONSOLE_UART, (const char *)p + off, n);
+    // A copy into free ring space takes microseconds; anything longer is
+    // waiting for the wire
+    int64_t took = hal_micros() - start;
+    if (took > 100) {
+      blockedUs += took;
+    }
+  }
+  portENTER_CRITICAL(&consoleStatsMux);
+  consoleStats.txBytes += len;
+  consoleStats.txBlockedUs += blockedUs;
+  portEXIT_CRITICAL(&consoleStatsMux);
+}
+
+size_t hal_console_read(uint8_t *data, size_t maxLen, uint32_t timeoutMs) {
+  // An event may cover more than maxLen bytes; take what is left over first
+  size_t buffered = 0;
+  uart_get_buffered_data_len(CONSOLE_UART, &buffered);
+  TickType_t wait = pdMS_TO_TICKS(timeoutMs);
+  uart_event_t event;
+  while (buffered == 0 && xQueueReceive(consoleEvents, &event, wait) == pdTRUE) {
+    if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+      // Input is lost anyway; drop the rest so the next line starts clean
+      uart_flush_input(CONSOLE_UART);
+      xQueueReset(consoleEvents);
+      portENTER_CRITICAL(&consoleStatsMux);
+      consoleStats.rxOverflows++;
+      portEXIT_CRITICAL(&consoleStatsMux);
+    }
+    uart_get_buffered_data_len(CONSOLE_UART, &buffered);
+  }
+  if (buffered == 0) {
+    return 0;
+  }
+  int got = uart_read_bytes(CONSOLE_UART, data, buffered < maxLen ? buffered : maxLen, 0);
+  if (got <= 0) {
+    return 0;
+  }
+  portENTER_CRITICAL(&consoleStatsMux);
+  consoleStats.rxBytes += got;
+  portEXIT_CRITICAL(&consoleStatsMux);
+  return got;
+}
+
+bool hal_console_flush(uint32_t timeoutMs) {
+  return uart_wait_tx_done(CONSOLE_UART, pdMS_TO_TICKS(timeoutMs)) == ESP_OK;
+}
+
+bool hal_console_set_baud(uint32_t baud) {
+  if (baud < CONSOLE_BAUD_MIN || baud > CONSOLE_BAUD_MAX) {
+    return false;
+  }
+  // A full TX ring at the slowest rate takes under 10 s to drain
+  hal_console_flush(10000);
+  if (uart_set_baudrate(CONSOLE_UART, baud) != ESP_OK) {
+    return false;
+  }
+  consoleBaud = baud;
+  return true;
+}
+
+uint32_t hal_console_baud() {
+  return consoleBaud;
+}
+
+void hal_console_get_stats(ConsoleStats *out) {
+  portENTER_CRITICAL(&consoleStatsMux);
+  *out = consoleStats;
+  portEXIT_CRITICAL(&consoleStatsMux);
+}
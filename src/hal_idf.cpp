@@ -0,0 +1,214 @@
+// Pure ESP-IDF backend (env:esp32dev-idf), no Arduino core
+#ifndef ARDUINO
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <driver/gpio.h>
+#include <driver/i2c_master.h>
+#include <driver/ledc.h>
+#include <driver/spi_master.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include "hal.h"
+
+#define I2C_TIMEOUT_MS 50
+
+static i2c_master_bus_handle_t i2cBus = NULL;
+static i2c_master_dev_handle_t i2cDevices[128];  // Created on first use per address
+static SemaphoreHandle_t i2cDevicesMutex = NULL;  // Tasks on both cores may add the same address
+static uint32_t i2cSpeed = 100000;
+
+// The console is in hal_console.cpp, shared with the Arduino build
+
+#define AUX_UART_RX_BUF 512
+
+bool hal_uart_begin(int port, int txPin, int rxPin, uint32_t baud) {
+  uart_config_t cfg = {};
+  cfg.baud_rate = (int)baud;
+  cfg.data_bits = UART_DATA_8_BITS;
+  cfg.parity = UART_PARITY_DISABLE;
+  cfg.stop_bits = UART_STOP_BITS_1;
+  cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  cfg.source_clk = UART_SCLK_DEFAULT;
+  return uart_driver_install((uart_port_t)port, AUX_UART_RX_BUF, 0, 0, NULL, 0) == ESP_OK &&
+         uart_param_config((uart_port_t)port, &cfg) == ESP_OK &&
+         uart_set_pin((uart_port_t)port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) == ESP_OK;
+}
+
+void hal_uart_write(int port, const void *data, size_t len) {
+  uart_write_bytes((uart_port_t)port, data, len);
+  uart_wait_tx_done((uart_port_t)port, portMAX_DELAY);
+}
+
+size_t hal_uart_read(int port, uint8_t *data, size_t maxLen, uint32_t timeoutMs) {
+  if (maxLen == 0) {
+    return 0;
+  }
+  int got = uart_read_bytes((uart_port_t)port, data, 1, pdMS_TO_TICKS(timeoutMs));
+  if (got <= 0) {
+    return 0;
+  }
+  size_t buffered = 0;
+  uart_get_buffered_data_len((uart_port_t)port, &buffered);
+  if (buffered > maxLen - 1) {
+    buffered = maxLen - 1;
+  }
+  if (buffered > 0) {
+    got += uart_read_bytes((uart_port_t)port, data + 1, buffered, 0);
+  }
+  return got;
+}
+
+uint32_t hal_millis() {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+int64_t hal_micros() {
+  return esp_timer_get_time();
+}
+
+void hal_delay_ms(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void hal_gpio_input(int pin) {
+  gpio_reset_pin((gpio_num_t)pin);
+  gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT);
+}
+
+void hal_gpio_output(int pin, int level) {
+  gpio_reset_pin((gpio_num_t)pin);
+  gpio_set_level((gpio_num_t)pin, level);
+  // INPUT_OUTPUT so the actual pin level can be read back
+  gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT);
+}
+
+void hal_gpio_write(int pin, int level) {
+  gpio_set_level((gpio_num_t)pin, level);
+}
+
+int hal_gpio_read(int pin) {
+  return gpio_get_level((gpio_num_t)pin);
+}
+
+void hal_pwm_init(int pin, int channel, uint32_t freq, int resolutionBits) {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)resolutionBits;
+  timer.timer_num = (ledc_timer_t)(channel / 2);  // Same channel->timer mapping as the Arduino core
+  timer.freq_hz = freq;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t ch = {};
+  ch.gpio_num = pin;
+  ch.speed_mode = LEDC_LOW_SPEED_MODE;
+  ch.channel = (ledc_channel_t)channel;
+  ch.timer_sel = timer.timer_num;
+  ch.duty = 0;
+  ch.hpoint = 0;
+  ledc_channel_config(&ch);
+}
+
+void hal_pwm_write(int channel, uint32_t duty) {
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel, duty);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel);
+}
+
+uint32_t hal_pwm_read(int channel) {
+  return ledc_get_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel);
+}
+
+bool hal_i2c_begin(int sda, int scl, uint32_t hz) {
+  i2c_master_bus_config_t cfg = {};
+  cfg.i2c_port = I2C_NUM_0;
+  cfg.sda_io_num = (gpio_num_t)sda;
+  cfg.scl_io_num = (gpio_num_t)scl;
+  cfg.clk_source = I2C_CLK_SRC_DEFAULT;
+  cfg.glitch_ignore_cnt = 7;
+  cfg.flags.enable_internal_pullup = true;
+  i2cSpeed = hz;
+  if (i2cDevicesMutex == NULL) {
+    i2cDevicesMutex = xSemaphoreCreateMutex();
+  }
+  return i2c_new_master_bus(&cfg, &i2cBus) == ESP_OK;
+}
+
+static i2c_master_dev_handle_t i2c_device(uint8_t addr) {
+  addr &= 0x7F;
+  xSemaphoreTake(i2cDevicesMutex, portMAX_DELAY);
+  if (i2cDevices[addr] == NULL) {
+    i2c_device_config_t dev = {};
+    dev.dev_addr_length = I2C_ADDR_BIT_LEN_7;
+    dev.device_address = addr;
+    dev.scl_speed_hz = i2cSpeed;
+    if (i2c_master_bus_add_device(i2cBus, &dev, &i2cDevices[addr]) != ESP_OK) {
+      i2cDevices[addr] = NULL;
+    }
+  }
+  i2c_master_dev_handle_t dev = i2cDevices[addr];
+  xSemaphoreGive(i2cDevicesMutex);
+  return dev;
+}
+
+bool hal_i2c_probe(uint8_t addr) {
+  int64_t start = hal_micros();
+  bool ok = i2c_master_probe(i2cBus, addr, I2C_TIMEOUT_MS) == ESP_OK;
+  hal_i2c_account(start, 0, ok);
+  return ok;
+}
+
+bool hal_i2c_write(uint8_t addr, const uint8_t *data, size_t len) {
+  int64_t start = hal_micros();
+  i2c_master_dev_handle_t dev = i2c_device(addr);
+  bool ok = dev != NULL && i2c_master_transmit(dev, data, len, I2C_TIMEOUT_MS) == ESP_OK;
+  hal_i2c_account(start, len, ok);
+  return ok;
+}
+
+bool hal_i2c_read(uint8_t addr, uint8_t *data, size_t len) {
+  int64_t start = hal_micros();
+  i2c_master_dev_handle_t dev = i2c_device(addr);
+  bool ok = dev != NULL && i2c_master_receive(dev, data, len, I2C_TIMEOUT_MS) == ESP_OK;
+  hal_i2c_account(start, len, ok);
+  return ok;
+}
+
+#define SPI_MAX_TRANSFER 4096
+
+static spi_device_handle_t spiDevice = NULL;
+
+bool hal_spi_begin(int sckPin, int mosiPin, int csPin, uint32_t hz) {
+  spi_bus_config_t bus = {};
+  bus.sclk_io_num = sckPin;
+  bus.mosi_io_num = mosiPin;
+  bus.miso_io_num = -1;
+  bus.quadwp_io_num = -1;
+  bus.quadhd_io_num = -1;
+  bus.max_transfer_sz = SPI_MAX_TRANSFER;
+  if (spi_bus_initialize(SPI2_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK) {
+    return false;
+  }
+  spi_device_interface_config_t dev = {};
+  dev.clock_speed_hz = (int)hz;
+  dev.mode = 0;
+  dev.spics_io_num = csPin;
+  dev.queue_size = 1;
+  return spi_bus_add_device(SPI2_HOST, &dev, &spiDevice) == ESP_OK;
+}
+
+void hal_spi_write(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (len > 0) {
+    size_t chunk = len < SPI_MAX_TRANSFER ? len : SPI_MAX_TRANSFER;
+    spi_transaction_t t = {};
+    t.length = chunk * 8;
+    t.tx_buffer = p;
+    spi_device_polling_transmit(spiDevice, &t);
+    p += chunk;
+    len -= chunk;
+  }
+}
+
+#endif  // !ARDUINO
@@ -0,0 +1,503 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_idf_version.h>
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+#include "console.h"
+#include "crc.h"
+#include "hal.h"
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_PARTITION_SUBTYPE 0x40
+#define HISTORY_MAP_WINDOW 0x10000  // One flash MMU page
+#define HISTORY_ERASED 0xFFFFFFFF
+#define HISTORY_MAX_SECTORS 256     // Block summaries kept in RAM (~15 KB)
+
+// esp_partition_mmap changed types between IDF 4.4 (Arduino core 2.x) and 5.x
+#if ESP_IDF_VERSION_MAJOR >= 5
+typedef esp_partition_mmap_handle_t history_map_handle_t;
+#define HISTORY_MMAP_DATA ESP_PARTITION_MMAP_DATA
+#define history_munmap esp_partition_munmap
+#else
+typedef spi_flash_mmap_handle_t history_map_handle_t;
+#define HISTORY_MMAP_DATA SPI_FLASH_MMAP_DATA
+#define history_munmap spi_flash_munmap
+#endif
+
+static const esp_partition_t *part = NULL;
+static SemaphoreHandle_t historyMutex = NULL;
+static uint32_t sectorCount = 0;
+static uint32_t headSector = 0;  // Next write position
+static uint32_t headSlot = 0;
+static uint32_t nextSeq = 0;
+static uint32_t oldestSeq = 0;
+static uint32_t oldestSector = 0;
+
+// Log time is uptime plus a base that moves forward at every reboot, so it
+// keeps increasing across boots. A reboot shows as uptime going backwards.
+struct LogClock {
+  uint32_t base;
+  uint32_t uptime;   // Of the last record
+  bool started;
+};
+
+// Per-sector block: the clock before its first record and the log time span
+struct HistoryBlock {
+  LogClock start;
+  uint32_t tFirst;
+  uint32_t tLast;
+  bool used;
+};
+
+static LogClock logClock = {0, 0, false};
+static HistoryBlock blocks[HISTORY_MAX_SECTORS];
+// Segment tree over the sectors: leaves at sectorCount + sector, node i
+// combines 2i and 2i+1
+static HistoryStats tree[2 * HISTORY_MAX_SECTORS];
+
+static uint32_t read_seq(uint32_t sector, uint32_t slot) {
+  uint32_t seq = HISTORY_ERASED;
+  esp_partition_read(part, sector * HISTORY_SECTOR_SIZE + slot * HISTORY_RECORD_SIZE, &seq, sizeof(seq));
+  return seq;
+}
+
+static uint32_t clock_time(const LogClock &clk, uint32_t uptime) {
+  if (clk.started && uptime < clk.uptime) {
+    return clk.base + clk.uptime + 1 + uptime;
+  }
+  return clk.base + uptime;
+}
+
+static uint32_t clock_tick(LogClock *clk, uint32_t uptime) {
+  uint32_t t = clock_time(*clk, uptime);
+  clk->base = t - uptime;
+  clk->uptime = uptime;
+  clk->started = true;
+  return t;
+}
+
+void history_stats_clear(HistoryStats *s) {
+  memset(s, 0, sizeof(*s));
+  s->humidityMin = INT16_MAX;
+  s->humidityMax = INT16_MIN;
+  s->temperatureMin = INT16_MAX;
+  s->temperatureMax = INT16_MIN;
+}
+
+void history_stats_merge(HistoryStats *into, const HistoryStats &other) {
+  into->samples += other.samples;
+  into->humiditySum += other.humiditySum;
+  into->temperatureSum += other.temperatureSum;
+  into->pumpSamples += other.pumpSamples;
+  into->valveSamples += other.valveSamples;
+  into->pumpStarts += other.pumpStarts;
+  if (other.humidityMin < into->humidityMin) into->humidityMin = other.humidityMin;
+  if (other.humidityMax > into->humidityMax) into->humidityMax = other.humidityMax;
+  if (other.temperatureMin < into->temperatureMin) into->temperatureMin = other.temperatureMin;
+  if (other.temperatureMax > into->temperatureMax) into->temperatureMax = other.temperatureMax;
+}
+
+void history_stats_add(HistoryStats *into, const HistoryRecord &rec) {
+  if (rec.type == HISTORY_CONTROL && rec.control.event == CONTROL_PUMP_START) {
+    into->pumpStarts++;
+  }
+  if (rec.type != HISTORY_SAMPLE) {
+    return;
+  }
+  HistoryStats one;
+  history_stats_clear(&one);
+  one.samples = 1;
+  one.humidityMin = one.humidityMax = rec.sample.humidity;
+  one.humiditySum = rec.sample.humidity;
+  one.temperatureMin = one.temperatureMax = rec.sample.temperature;
+  one.temperatureSum = rec.sample.temperature;
+  one.pumpSamples = rec.flags & HISTORY_FLAG_PUMP ? 1 : 0;
+  one.valveSamples = rec.flags & HISTORY_FLAG_VALVE ? 1 : 0;
+  history_stats_merge(into, one);
+}
+
+static void tree_update(uint32_t sector) {
+  for (uint32_t i = (sectorCount + sector) / 2; i >= 1; i /= 2) {
+    tree[i] = tree[2 * i];
+    history_stats_merge(&tree[i], tree[2 * i + 1]);
+  }
+}
+
+static void tree_build() {
+  for (uint32_t i = sectorCount - 1; i >= 1; i--) {
+    tree[i] = tree[2 * i];
+    history_stats_merge(&tree[i], tree[2 * i + 1]);
+  }
+}
+
+// Merges the leaves of physical sectors [l, r)
+static void tree_query(uint32_t l, uint32_t r, HistoryStats *out) {
+  for (l += sectorCount, r += sectorCount; l < r; l /= 2, r /= 2) {
+    if (l & 1) {
+      history_stats_merge(out, tree[l++]);
+    }
+    if (r & 1) {
+      history_stats_merge(out, tree[--r]);
+    }
+  }
+}
+
+static void block_reset(uint32_t sector) {
+  blocks[sector].used = false;
+  history_stats_clear(&tree[sectorCount + sector]);
+}
+
+// Adds one record to its sector's block; the caller updates the tree
+static void block_add(uint32_t sector, const HistoryRecord &rec) {
+  HistoryBlock &b = blocks[sector];
+  LogClock before = logClock;
+  uint32_t t = clock_tick(&logClock, rec.uptime);
+  if (!b.used) {
+    b.start = before;
+    b.tFirst = t;
+    b.used = true;
+  }
+  b.tLast = t;
+  history_stats_add(&tree[sectorCount + sector], rec);
+}
+
+static const HistoryRecord *map_sector(uint32_t sector, history_map_handle_t *handle) {
+  const void *mapped = NULL;
+  if (esp_partition_mmap(part, sector * HISTORY_SECTOR_SIZE, HISTORY_SECTOR_SIZE, HISTORY_MMAP_DATA, &mapped,
+                         handle) != ESP_OK) {
+    return NULL;
+  }
+  return (const HistoryRecord *)mapped;
+}
+
+static bool record_valid(const HistoryRecord &rec) {
+  return rec.seq != HISTORY_ERASED && crc16_ccitt(&rec, offsetof(HistoryRecord, crc)) == rec.crc;
+}
+
+// Boot: replays every stored record, oldest first, into the block summaries
+static void index_build() {
+  for (uint32_t s = 0; s < sectorCount; s++) {
+    block_reset(s);
+  }
+  for (uint32_t k = 0; k < sectorCount; k++) {
+    uint32_t s = (oldestSector + k) % sectorCount;
+    history_map_handle_t handle;
+    const HistoryRecord *recs = map_sector(s, &handle);
+    if (recs != NULL) {
+      for (uint32_t i = 0; i < HISTORY_PER_SECTOR && recs[i].seq != HISTORY_ERASED; i++) {
+        if (record_valid(recs[i])) {
+          block_add(s, recs[i]);
+        }
+      }
+      history_munmap(handle);
+    }
+    if (s == headSector) {
+      break;
+    }
+  }
+  tree_build();
+}
+
+// Adds the records of one sector that fall in [from, to]
+static void scan_sector(uint32_t sector, uint32_t from, uint32_t to, HistoryStats *out) {
+  history_map_handle_t handle;
+  const HistoryRecord *recs = map_sector(sector, &handle);
+  if (recs == NULL) {
+    return;
+  }
+  LogClock clk = blocks[sector].start;
+  for (uint32_t i = 0; i < HISTORY_PER_SECTOR && recs[i].seq != HISTORY_ERASED; i++) {
+    if (!record_valid(recs[i])) {
+      continue;
+    }
+    uint32_t t = clock_tick(&clk, recs[i].uptime);
+    if (t >= from && t <= to) {
+      history_stats_add(out, recs[i]);
+    }
+  }
+  history_munmap(handle);
+}
+
+uint32_t history_now() {
+  if (part == NULL) {
+    return 0;
+  }
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  uint32_t t = clock_time(logClock, hal_millis() / 1000);
+  xSemaphoreGive(historyMutex);
+  return t;
+}
+
+bool history_query(uint32_t from, uint32_t to, HistoryStats *out) {
+  history_stats_clear(out);
+  if (part == NULL) {
+    return false;
+  }
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+
+  // Sectors in log order are oldestSector .. headSector, and their time spans
+  // are sorted; binary search for the first and last one touching the range
+  uint32_t used = (headSector + sectorCount - oldestSector) % sectorCount + 1;
+  if (!blocks[headSector].used) {
+    used--;
+  }
+  uint32_t lo = 0, hi = used;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (blocks[(oldestSector + mid) % sectorCount].tLast < from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  uint32_t first = lo;
+  hi = used;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (blocks[(oldestSector + mid) % sectorCount].tFirst <= to) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  uint32_t end = lo;   // One past the last sector touching the range
+
+  if (first < end) {
+    // Partly covered sectors at either end are scanned record by record
+    uint32_t s = (oldestSector + first) % sectorCount;
+    if (blocks[s].tFirst < from || blocks[s].tLast > to) {
+      scan_sector(s, from, to, out);
+      first++;
+    }
+    if (first < end) {
+      s = (oldestSector + end - 1) % sectorCount;
+      if (blocks[s].tLast > to) {
+        scan_sector(s, from, to, out);
+        end--;
+      }
+    }
+    // Fully covered sectors come from the tree, in up to two physical runs
+    if (first < end) {
+      uint32_t l = (oldestSector + first) % sectorCount;
+      uint32_t r = (oldestSector + end - 1) % sectorCount + 1;
+      if (l < r) {
+        tree_query(l, r, out);
+      } else {
+        tree_query(l, sectorCount, out);
+        tree_query(0, r, out);
+      }
+    }
+  }
+
+  xSemaphoreGive(historyMutex);
+  return true;
+}
+
+static void history_stats_command(uint32_t hours) {
+  uint32_t now = history_now();
+  uint32_t span = hours * 3600;
+  int64_t start = hal_micros();
+  HistoryStats st;
+  history_query(now > span ? now - span : 0, now, &st);
+  unsigned us = (unsigned)(hal_micros() - start);
+
+  hal_printf("Last %uh: %u samples (query %u us)\n", (unsigned)hours, st.samples, us);
+  if (st.samples == 0) {
+    return;
+  }
+  int avgH = st.humiditySum / st.samples;
+  int avgT = st.temperatureSum / st.samples;
+  hal_printf("  humidity %d.%d..%d.%d%%, avg %d.%d%%\n", st.humidityMin / 10, abs(st.humidityMin % 10),
+             st.humidityMax / 10, abs(st.humidityMax % 10), avgH / 10, abs(avgH % 10));
+  hal_printf("  temperature %d.%d..%d.%dC, avg %d.%dC\n", st.temperatureMin / 10, abs(st.temperatureMin % 10),
+             st.temperatureMax / 10, abs(st.temperatureMax % 10), avgT / 10, abs(avgT % 10));
+  hal_printf("  pump %u min, %u starts, valve %u min\n", (unsigned)(st.pumpSamples * HISTORY_SAMPLE_S / 60),
+             st.pumpStarts, (unsigned)(st.valveSamples * HISTORY_SAMPLE_S / 60));
+}
+
+static void history_command(int argc, char **argv) {
+  if (argc >= 2 && strcmp(argv[1], "export") == 0) {
+    history_export();
+    return;
+  }
+  if (argc >= 2 && strcmp(argv[1], "stats") == 0) {
+    history_stats_command(argc >= 3 ? strtoul(argv[2], NULL, 10) : 24);
+    return;
+  }
+  hal_printf("History: %u of %u records, next seq %u\n",
+             (unsigned)history_count(), (unsigned)history_capacity(), (unsigned)nextSeq);
+}
+
+bool history_begin() {
+  part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)HISTORY_PARTITION_SUBTYPE,
+                                  HISTORY_PARTITION_LABEL);
+  if (part == NULL) {
+    hal_printf("History partition not found\n");
+    return false;
+  }
+  historyMutex = xSemaphoreCreateMutex();
+  sectorCount = part->size / HISTORY_SECTOR_SIZE;
+  if (sectorCount > HISTORY_MAX_SECTORS) {
+    sectorCount = HISTORY_MAX_SECTORS;   // The rest of a larger partition stays unused
+  }
+
+  // Every sector starts with a consecutive run of seqs, so the head sector is
+  // the one whose first record has the highest seq
+  bool found = false;
+  uint32_t maxSeq = 0;
+  uint32_t minSeq = HISTORY_ERASED;
+  for (uint32_t s = 0; s < sectorCount; s++) {
+    uint32_t seq = read_seq(s, 0);
+    if (seq == HISTORY_ERASED) {
+      continue;
+    }
+    if (!found || seq > maxSeq) {
+      maxSeq = seq;
+      headSector = s;
+    }
+    if (seq < minSeq) {
+      minSeq = seq;
+      oldestSector = s;
+    }
+    found = true;
+  }
+
+  if (!found) {
+    esp_partition_erase_range(part, 0, HISTORY_SECTOR_SIZE);
+    headSector = 0;
+    headSlot = 0;
+    nextSeq = 0;
+    oldestSeq = 0;
+  } else {
+    headSlot = 1;
+    while (headSlot < HISTORY_PER_SECTOR && read_seq(headSector, headSlot) != HISTORY_ERASED) {
+      headSlot++;
+    }
+    nextSeq = maxSeq + headSlot;
+    oldestSeq = minSeq;
+  }
+
+  index_build();
+
+  console_register("history", "Show log status; 'history stats [hours]' aggregates, 'history export' streams it",
+                   history_command);
+  hal_printf("History: %u records, %u sectors\n", (unsigned)history_count(), (unsigned)sectorCount);
+  return true;
+}
+
+bool history_append(HistoryRecord *rec) {
+  if (part == NULL) {
+    return false;
+  }
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+
+  if (headSlot >= HISTORY_PER_SECTOR) {
+    // Move to the next sector, dropping the oldest one if the ring is full
+    headSector = (headSector + 1) % sectorCount;
+    headSlot = 0;
+    uint32_t dropped = read_seq(headSector, 0);
+    esp_partition_erase_range(part, headSector * HISTORY_SECTOR_SIZE, HISTORY_SECTOR_SIZE);
+    if (dropped != HISTORY_ERASED) {
+      oldestSeq = dropped + HISTORY_PER_SECTOR;
+      oldestSector = (headSector + 1) % sectorCount;
+    }
+    block_reset(headSector);
+  }
+
+  rec->seq = nextSeq;
+  rec->uptime = hal_millis() / 1000;
+  rec->crc = crc16_ccitt(rec, offsetof(HistoryRecord, crc));
+  esp_err_t err = esp_partition_write(part, headSector * HISTORY_SECTOR_SIZE + headSlot * HISTORY_RECORD_SIZE,
+                                      rec, sizeof(*rec));
+  // Consume the slot even on error so a bad cell does not wedge the log
+  headSlot++;
+  nextSeq++;
+  if (err == ESP_OK) {
+    block_add(headSector, *rec);
+  }
+  tree_update(headSector);
+
+  xSemaphoreGive(historyMutex);
+  return err == ESP_OK;
+}
+
+bool history_log_event(uint16_t code, int16_t arg, int32_t value, const char *text) {
+  HistoryRecord rec = {};
+  rec.type = HISTORY_EVENT;
+  rec.event.code = code;
+  rec.event.arg = arg;
+  rec.event.value = value;
+  if (text != NULL) {
+    strncpy(rec.event.text, text, sizeof(rec.event.text) - 1);
+  }
+  return history_append(&rec);
+}
+
+uint32_t history_count() {
+  return nextSeq - oldestSeq;
+}
+
+uint32_t history_capacity() {
+  return (sectorCount - 1) * HISTORY_PER_SECTOR;
+}
+
+bool history_export() {
+  if (part == NULL) {
+    return false;
+  }
+
+  // Snapshot the ring; appends continue during the export. If the writer wraps
+  // into a sector that is still being sent, the receiver sees the seq jump.
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  uint32_t count = nextSeq - oldestSeq;
+  uint32_t total = sectorCount * HISTORY_PER_SECTOR;
+  uint32_t index = (headSector * HISTORY_PER_SECTOR + headSlot + total - count) % total;
+  HistoryExportInfo info = {count, oldestSeq, HISTORY_RECORD_SIZE, HISTORY_FRAME_RECORDS};
+  xSemaphoreGive(historyMutex);
+
+  uint32_t start = hal_millis();
+  uint32_t sent = 0;
+  console_begin_binary();
+  console_send_frame(FRAME_HISTORY_BEGIN, &info, sizeof(info));
+
+  while (sent < count) {
+    // Map one MMU page worth of the partition and send frames straight out of it
+    uint32_t offset = index * HISTORY_RECORD_SIZE;
+    uint32_t windowBase = offset & ~(uint32_t)(HISTORY_MAP_WINDOW - 1);
+    uint32_t windowSize = part->size - windowBase < HISTORY_MAP_WINDOW ? part->size - windowBase : HISTORY_MAP_WINDOW;
+    const void *mapped = NULL;
+    history_map_handle_t handle;
+    if (esp_partition_mmap(part, windowBase, windowSize, HISTORY_MMAP_DATA, &mapped, &handle) != ESP_OK) {
+      break;
+    }
+
+    while (sent < count && offset < windowBase + windowSize) {
+      uint32_t n = count - sent;
+      if (n > HISTORY_FRAME_RECORDS) {
+        n = HISTORY_FRAME_RECORDS;
+      }
+      uint32_t room = (windowBase + windowSize - offset) / HISTORY_RECORD_SIZE;
+      if (n > room) {
+        n = room;
+      }
+      console_send_frame(FRAME_HISTORY_DATA, (const uint8_t *)mapped + (offset - windowBase),
+                         n * HISTORY_RECORD_SIZE);
+      sent += n;
+      index = (index + n) % total;
+      offset = index * HISTORY_RECORD_SIZE;
+      if (index == 0) {
+        break;  // Wrapped to the start of the partition, remap
+      }
+    }
+    history_munmap(handle);
+  }
+
+  HistoryExportDone done = {sent, hal_millis() - start};
+  console_send_frame(FRAME_HISTORY_END, &done, sizeof(done));
+  console_end_binary();
+  return sent == count;
+}
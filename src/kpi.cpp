@@ -0,0 +1,93 @@
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "kpi.h"
+#include "console.h"
+#include "hal.h"
+
+static KpiAccumulator today;
+static HistoryKpi yesterday;
+static bool haveYesterday = false;
+static portMUX_TYPE kpiMux = portMUX_INITIALIZER_UNLOCKED;
+
+void kpi_summarize(const KpiAccumulator *acc, HistoryKpi *out) {
+  out->inBandPermille = acc->seconds ? (uint16_t)((uint64_t)acc->inBandS * 1000 / acc->seconds) : 0;
+  out->maxOvershoot = acc->maxOvershoot;
+  out->overshootArea = acc->overshootArea;
+  out->waterMl = (uint32_t)((uint64_t)acc->pumpSeconds * PUMP_FLOW_ML_PER_MIN / 60);
+  out->rhHours = acc->rhSeconds / 3600;
+  out->pumpStarts = acc->starts > 0xFFFF ? 0xFFFF : (uint16_t)acc->starts;
+  out->pumpMinutes = (uint16_t)(acc->pumpSeconds / 60);
+}
+
+static void kpi_rollup() {
+  HistoryRecord rec = {};
+  rec.type = HISTORY_KPI;
+  portENTER_CRITICAL(&kpiMux);
+  kpi_summarize(&today, &rec.kpi);
+  uint32_t base = today.startsBase + today.starts;
+  memset(&today, 0, sizeof(today));
+  today.startsBase = base;
+  yesterday = rec.kpi;
+  haveYesterday = true;
+  portEXIT_CRITICAL(&kpiMux);
+  history_append(&rec);
+}
+
+void kpi_tick(int16_t humidity, int16_t preset, int pumpsRunning, uint32_t pumpStartsTotal) {
+  portENTER_CRITICAL(&kpiMux);
+  today.elapsedS++;
+  today.pumpSeconds += pumpsRunning;
+  today.starts = pumpStartsTotal - today.startsBase;
+  if (humidity > 0) {
+    int32_t error = humidity - preset;
+    today.seconds++;
+    today.rhSeconds += humidity;
+    if (error >= -KPI_BAND && error <= KPI_BAND) {
+      today.inBandS++;
+    }
+    if (error > 0) {
+      today.overshootArea += error;
+      if (error > today.maxOvershoot) {
+        today.maxOvershoot = (int16_t)error;
+      }
+    }
+  }
+  bool dayDone = today.elapsedS >= KPI_DAY_S;
+  portEXIT_CRITICAL(&kpiMux);
+
+  if (dayDone) {
+    kpi_rollup();
+  }
+}
+
+static void kpi_print(const char *label, const HistoryKpi &k, uint32_t hours) {
+  // ml per %RH-hour, rhHours is in 0.1 %RH * h
+  uint32_t mlPerRhH = k.rhHours ? (uint32_t)((uint64_t)k.waterMl * 10 / k.rhHours) : 0;
+  hal_printf("%s (%uh): in band %u.%u%%, max overshoot %d.%d%%, overshoot %u %%RH*min\n", label, (unsigned)hours,
+             k.inBandPermille / 10, k.inBandPermille % 10, k.maxOvershoot / 10, k.maxOvershoot % 10,
+             (unsigned)(k.overshootArea / 600));
+  hal_printf("  water %u ml, %u ml per %%RH-h, pump %u min, %u starts\n", (unsigned)k.waterMl, (unsigned)mlPerRhH,
+             k.pumpMinutes, k.pumpStarts);
+}
+
+static void kpi_command(int argc, char **argv) {
+  HistoryKpi now, last;
+  bool haveLast;
+  uint32_t hours;
+  portENTER_CRITICAL(&kpiMux);
+  kpi_summarize(&today, &now);
+  hours = today.elapsedS / 3600;
+  last = yesterday;
+  haveLast = haveYesterday;
+  portEXIT_CRITICAL(&kpiMux);
+
+  kpi_print("Today", now, hours);
+  if (haveLast) {
+    kpi_print("Last day", last, KPI_DAY_S / 3600);
+  }
+}
+
+void kpi_begin(uint32_t pumpStartsTotal) {
+  today.startsBase = pumpStartsTotal;
+  console_register("kpi", "Comfort/efficiency KPIs for today and the last full day", kpi_command);
+}
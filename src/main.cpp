@@ -1,222 +1,85 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
-#include <Fonts/FreeSans9pt7b.h>  // Custom font ~1.5x size
-#include <DHT20.h>            // For DHT20 (robtillaart/DHT20)
+#include <math.h>
+#include "hal.h"              // Arduino or pure ESP-IDF backend, see platformio.ini
+#include "display.h"
+#include "display_panels.h"
+#include "sensor_drivers.h"
+#include "console.h"
+#include "history.h"
+#include "coord.h"
+#include "selftest.h"
+#include "periods.h"
+#include "controller.h"
+#include "safety.h"
+#include "ota.h"
 
 
 // Pin definitions
 #define I2C_SDA 21
 #define I2C_SCL 22
-#define DHTPIN 23  // unused by DHT20 (kept for compatibility)
-#define WATER_LEVEL_PIN 35
-#define PUMP_PWM_PIN 25
-#define VALVE_PIN 26
+#if DISPLAY_PANEL == PANEL_SSD1322
+#define SCREEN_WIDTH 256
+#else
 #define SCREEN_WIDTH 128
+#endif
 #define SCREEN_HEIGHT 64
 #define OLED_ADDR 0x3C
+#define I2C_FREQ 100000
 
-// PWM configuration for motor control
-#define PWM_FREQ 1000      // 1 kHz (suitable for motor control)
-#define PWM_CHANNEL 0
-#define PWM_RESOLUTION 8   // 8-bit resolution (0-255)
-#define PWM_DUTY_85 217    // 85% of 255
-
-// Water level detection
-#define DEBOUNCE_COUNT 10  // Number of consecutive reads needed to change state// Add calibration offsets at the top of your file
-#define HUMIDITY_OFFSET -10.0  // Adjust based on comparison with reference
-#define HUMIDITY_PRESET 50.0  // Preset value for humidity
+#define HISTORY_PERIOD_MS (HISTORY_SAMPLE_S * 1000)
+#define DISPLAY_STATS_EVERY 10    // Every 10th display update shows the 24 h stats page
 
 
 // Sensor objects
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
-DHT20 dht;
-
-// Shared variables (protected by mutex if needed)
-float temperature = 0.0;
-float humidity = 0.0;
-bool waterEmpty = false;
-int lowVoltageCount = 0;
-int highVoltageCount = 0;
-bool valveActive = false;
-bool pumpActive = false;
-int countdown = 0;
-bool valveHasRun = false;  // Track if valve has already run for this empty cycle
-
-// Pump cycle state
-enum PumpState { PUMP_IDLE, PUMP_RUNNING, PUMP_WAITING };
-PumpState pumpState = PUMP_IDLE;
-
+#if DISPLAY_PANEL == PANEL_SSD1322
+Ssd1322Panel panel(SCREEN_WIDTH, SCREEN_HEIGHT);
+#elif DISPLAY_PANEL == PANEL_SH1106
+Sh1106Panel panel(SCREEN_WIDTH, SCREEN_HEIGHT, OLED_ADDR);
+#else
+Ssd1306Panel panel(SCREEN_WIDTH, SCREEN_HEIGHT, OLED_ADDR);
+#endif
+Display display(&panel);
+HumiditySensor sensor;   // HUMIDITY_SENSOR build flag, see sensor_drivers.h
 
 // Sensor reading task
 void sensor_task(void *pvParameters) {
   while (1) {
-    // Read DHT20
-    int status = dht.read();
-    if (status == DHT20_OK) {
-      float temp = dht.getTemperature();
-      float hum = dht.getHumidity();
-      Serial.printf("Raw DHT20 - Temp: %.2f°C, Humidity: %.2f%%\n", temp, hum);
-      
-      if (!isnan(temp) && !isnan(hum)) {
-        temperature = temp;
-        humidity = hum + HUMIDITY_OFFSET;
-      }
-    } else {
-      Serial.printf("DHT20 read error: %d\n", status);
+    // Direct call on the concrete driver type, no virtual dispatch
+    int status = sensor.read();
+    if (status == SENSOR_OK) {
+      float temp = sensor.getTemperature();
+      float hum = sensor.getHumidity();
+      hal_printf("Raw %s - Temp: %.2f°C, Humidity: %.2f%%\n", HumiditySensor::name(), temp, hum);
+      controller_reading(temp, hum);
+    } else if (status != SENSOR_NO_DATA) {
+      hal_printf("%s read error: %d\n", HumiditySensor::name(), status);
     }
 
 
-    vTaskDelay(2000 / portTICK_PERIOD_MS); // Read every 2 seconds (DHT20 needs >1000ms between reads)
+    vTaskDelay(period_ms(PERIOD_SENSOR) / portTICK_PERIOD_MS); // 2 s by default, at least HumiditySensor::MIN_PERIOD_MS
   }
 }
 
 // Water level monitoring task
 void water_level_task(void *pvParameters) {
   while (1) {
-    int voltage = digitalRead(WATER_LEVEL_PIN);
-    
-    if (voltage == HIGH) {
-      // High voltage detected - water empty
-      lowVoltageCount++;
-      highVoltageCount = 0;  // Reset high voltage counter
-      
-      if (lowVoltageCount >= DEBOUNCE_COUNT && !waterEmpty) {
-        waterEmpty = true;
-        Serial.println("WATER EMPTY detected!");
-      }
-    } else {
-      // Low voltage detected - water OK
-      highVoltageCount++;
-      lowVoltageCount = 0;  // Reset low voltage counter
-      
-      if (highVoltageCount >= DEBOUNCE_COUNT && waterEmpty) {
-        waterEmpty = false;
-        Serial.println("Water level OK");
-      }
-    }
-    
-    vTaskDelay(1000 / portTICK_PERIOD_MS); // Check every 1 second
+    controller_level(hal_gpio_read(WATER_LEVEL_PIN));
+    vTaskDelay(period_ms(PERIOD_LEVEL) / portTICK_PERIOD_MS); // Debounce time is DEBOUNCE_COUNT periods
   }
 }
 
 // Valve and pump control task
 void control_task(void *pvParameters) {
+  uint32_t msAcc = 0;
   while (1) {
-    // Priority 1: If humidity >= preset, stop everything
-    if (humidity >= HUMIDITY_PRESET) {
-      if (valveActive) {
-        digitalWrite(VALVE_PIN, LOW);
-        valveActive = false;
-        countdown = 0;
-        Serial.println("Valve stopped - humidity reached preset");
-      }
-      if (pumpActive) {
-        ledcWrite(PWM_CHANNEL, 0);
-        pumpActive = false;
-        countdown = 0;
-        pumpState = PUMP_IDLE;
-        Serial.println("Pump stopped - humidity reached preset");
-      }
-      vTaskDelay(1000 / portTICK_PERIOD_MS);
-      continue;
-    }
-    
-    // Priority 2: Valve is active - let it complete regardless of waterEmpty status
-    if (valveActive) {
-      // Stop pump if running
-      if (pumpActive) {
-        ledcWrite(PWM_CHANNEL, 0);
-        pumpActive = false;
-        pumpState = PUMP_IDLE;
-        Serial.println("Pump stopped - valve active");
-      }
-      
-      // Continue valve countdown
-      if (countdown > 0) {
-        countdown--;
-      } else {
-        digitalWrite(VALVE_PIN, LOW);
-        valveActive = false;
-        valveHasRun = true;
-        Serial.println("Valve stopped after countdown complete");
-      }
-      
-      vTaskDelay(1000 / portTICK_PERIOD_MS);
-      continue;  // Skip all other logic while valve is active
-    }
-    
-    // Priority 3: Water is empty and valve not active - start valve
-    if (waterEmpty && !valveHasRun) {
-      // Stop pump immediately if running
-      if (pumpActive) {
-        ledcWrite(PWM_CHANNEL, 0);
-        pumpActive = false;
-        countdown = 0;
-        pumpState = PUMP_IDLE;
-        Serial.println("Pump stopped - water empty");
-      }
-      
-      // Start valve
-      digitalWrite(VALVE_PIN, HIGH);
-      valveActive = true;
-      countdown = 180;
-      Serial.println("Valve started - filling water for 180s");
-      
-      vTaskDelay(1000 / portTICK_PERIOD_MS);
-      continue;
-    }
-    
-    // Priority 4: Water is OK - reset valve flag and run pump cycles
-    if (!waterEmpty) {
-      valveHasRun = false;  // Reset flag when water is OK
-    }
-    
-    // Pump state machine - only runs when water is OK, humidity < preset, and valve is not active
-    if (!waterEmpty && !valveActive) {
-      switch (pumpState) {
-        case PUMP_IDLE:
-          // Start pump cycle
-          ledcWrite(PWM_CHANNEL, PWM_DUTY_85);
-          pumpActive = true;
-          countdown = 60;
-          pumpState = PUMP_RUNNING;
-          Serial.println("Pump started for 60s at 85%");
-          break;
-          
-        case PUMP_RUNNING:
-          if (countdown > 0) {
-            countdown--;
-          } else {
-            // Pump cycle complete, stop pump
-            ledcWrite(PWM_CHANNEL, 0);
-            pumpActive = false;
-            countdown = 60;
-            pumpState = PUMP_WAITING;
-            Serial.println("Pump stopped, waiting 60s");
-          }
-          break;
-          
-        case PUMP_WAITING:
-          if (countdown > 0) {
-            countdown--;
-          } else {
-            // Wait complete, restart cycle
-            pumpState = PUMP_IDLE;
-          }
-          break;
-      }
-    } else {
-      // Water empty or valve active - stop pump if running
-      if (pumpActive) {
-        ledcWrite(PWM_CHANNEL, 0);
-        pumpActive = false;
-        pumpState = PUMP_IDLE;
-      }
-    }
-    
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    // Countdowns, KPIs and the learned load count whole seconds, whatever
+    // the control period
+    msAcc += period_ms(PERIOD_CONTROL);
+    controller_tick(msAcc / 1000);
+    msAcc %= 1000;
+
+    vTaskDelay(period_ms(PERIOD_CONTROL) / portTICK_PERIOD_MS);
   }
 }
 
@@ -226,11 +89,35 @@ void display_task(void *pvParameters) {
   const int scrollSpeed = 2; // Pixels per update
   const int maxScroll = 40;  // Maximum scroll distance
   
+  uint32_t updates = 0;
+
   while (1) {
     display.clearDisplay();
     display.setTextSize(1);  // Use 1x size to fit 5 lines
-    display.setTextColor(SSD1306_WHITE);
-    
+    display.setTextColor(DISPLAY_WHITE);
+
+    // Stats page: last 24 h from the history block summaries
+    if (++updates % DISPLAY_STATS_EVERY == 0) {
+      HistoryStats st;
+      uint32_t now = history_now();
+      history_query(now > 86400 ? now - 86400 : 0, now, &st);
+      display.setCursor(0, 0);
+      display.printf("LAST 24H");
+      if (st.samples > 0) {
+        display.setCursor(0, 13);
+        display.printf("RH %.1f-%.1f%%", st.humidityMin / 10.0, st.humidityMax / 10.0);
+        display.setCursor(0, 26);
+        display.printf("AVG %.1f%% %.1fC", st.humiditySum / 10.0 / st.samples, st.temperatureSum / 10.0 / st.samples);
+        display.setCursor(0, 39);
+        display.printf("PUMP %u MIN", (unsigned)(st.pumpSamples * HISTORY_SAMPLE_S / 60));
+        display.setCursor(0, 52);
+        display.printf("STARTS %u", st.pumpStarts);
+      }
+      display.display();
+      vTaskDelay(period_ms(PERIOD_DISPLAY) / portTICK_PERIOD_MS);
+      continue;
+    }
+
     // Calculate scroll position (oscillate back and forth)
     int xPos = scrollOffset % (maxScroll * 2);
     if (xPos > maxScroll) {
@@ -247,7 +134,7 @@ void display_task(void *pvParameters) {
     display.setCursor(xPos, 39);
     display.printf("WATER: %s", waterEmpty ? "EMPTY" : "OK");
     display.setCursor(xPos, 52);
-    if (humidity >= HUMIDITY_PRESET) {
+    if (targetReached) {
       display.printf("TARGET REACHED");
     } else if (valveActive) {
       display.printf("VALVE: ON %ds", countdown);
@@ -261,76 +148,215 @@ void display_task(void *pvParameters) {
     display.display();
 
     scrollOffset += scrollSpeed;
-    vTaskDelay(1000 / portTICK_PERIOD_MS); // Update every 1 second
+    vTaskDelay(period_ms(PERIOD_DISPLAY) / portTICK_PERIOD_MS);
+  }
+}
+
+// Telemetry logging task
+void history_task(void *pvParameters) {
+  while (1) {
+    vTaskDelay(HISTORY_PERIOD_MS / portTICK_PERIOD_MS);
+
+    HistoryRecord rec = {};
+    rec.type = HISTORY_SAMPLE;
+    rec.flags = (pumpActive ? HISTORY_FLAG_PUMP : 0) | (valveActive ? HISTORY_FLAG_VALVE : 0) |
+                (waterEmpty ? HISTORY_FLAG_WATER_EMPTY : 0);
+    rec.sample.humidity = (int16_t)lroundf(humidity * 10);
+    rec.sample.temperature = (int16_t)lroundf(temperature * 10);
+    rec.sample.preset = (int16_t)lroundf(HUMIDITY_PRESET * 10);
+    rec.sample.countdown = countdown;
+    rec.sample.pumpState = pumpState;
+    if (!history_append(&rec)) {
+      hal_printf("History write failed\n");
+    }
+  }
+}
+
+// Display transfer cost; with dirty tracking only changed columns are sent
+void display_command(int argc, char **argv) {
+  uint32_t frames = display.frames();
+  hal_printf("Display %dx%d: %u frames, %u bytes sent, avg %u bytes/frame\n", display.width(), display.height(),
+             (unsigned)frames, (unsigned)display.bytesSent(), frames ? (unsigned)(display.bytesSent() / frames) : 0u);
+}
+
+// A freshly updated image is confirmed only if it passed the self-test, has
+// readings from the sensor and no safety fault after OTA_HEALTH_S
+static bool boot_healthy() {
+  return selftest_passed() && humidity > 0 && !safety_latched();
+}
+
+// Boot self-test checks, run concurrently by selftest_run()
+
+// Driver health check (status register or serial number with CRC), then one
+// full measurement. A periodic-mode sensor has no sample yet this early.
+SelfTestResult selftest_sensor(int32_t *detail) {
+  int err = sensor.check();
+  if (err != SENSOR_OK || HumiditySensor::PERIODIC) {
+    *detail = err;
+    return err == SENSOR_OK ? SELFTEST_PASS : SELFTEST_FAIL;
+  }
+  err = sensor.read();
+  if (err != SENSOR_OK) {
+    *detail = err;
+    return SELFTEST_FAIL;
+  }
+  *detail = lroundf(sensor.getHumidity() * 10);
+  return sensor.getHumidity() > 0 && sensor.getHumidity() <= 100 ? SELFTEST_PASS : SELFTEST_FAIL;
+}
+
+SelfTestResult selftest_display(int32_t *detail) {
+#if DISPLAY_PANEL == PANEL_SSD1322
+  return SELFTEST_SKIP;   // SPI panel, nothing to read back
+#else
+  *detail = OLED_ADDR;
+  return hal_i2c_probe(OLED_ADDR) ? SELFTEST_PASS : SELFTEST_FAIL;
+#endif
+}
+
+// A floating or chattering level input shows up as changes within 100 ms
+SelfTestResult selftest_level(int32_t *detail) {
+  int first = hal_gpio_read(WATER_LEVEL_PIN);
+  int changes = 0;
+  for (int i = 0; i < 20; i++) {
+    hal_delay_ms(5);
+    if (hal_gpio_read(WATER_LEVEL_PIN) != first) {
+      changes++;
+    }
   }
+  *detail = changes;
+  return changes == 0 ? SELFTEST_PASS : SELFTEST_FAIL;
+}
+
+// Drives the valve for 50 ms and checks the pin follows. The pumps have no
+// feedback, so they are not part of the self-test.
+SelfTestResult selftest_valve(int32_t *detail) {
+#if SELFTEST_PULSE_OUTPUTS
+  hal_gpio_write(VALVE_PIN, HIGH);
+  hal_delay_ms(50);
+  int on = hal_gpio_read(VALVE_PIN);
+  hal_gpio_write(VALVE_PIN, LOW);
+  hal_delay_ms(5);
+  int off = hal_gpio_read(VALVE_PIN);
+  *detail = on << 1 | off;
+  return on == HIGH && off == LOW ? SELFTEST_PASS : SELFTEST_FAIL;
+#else
+  return SELFTEST_SKIP;
+#endif
 }
 
+static const SelfTest bootTests[] = {
+  {"sensor", selftest_sensor},
+  {"display", selftest_display},
+  {"level", selftest_level},
+  {"valve", selftest_valve},
+};
+
 void scanI2C() {
-  Serial.println("\nScanning I2C bus...");
-  byte count = 0;
-  for (byte i = 1; i < 127; i++) {
-    Wire.beginTransmission(i);
-    if (Wire.endTransmission() == 0) {
-      Serial.printf("Found device at 0x%02X\n", i);
+  hal_printf("\nScanning I2C bus...\n");
+  uint8_t count = 0;
+  for (uint8_t i = 1; i < 127; i++) {
+    if (hal_i2c_probe(i)) {
+      hal_printf("Found device at 0x%02X\n", i);
       count++;
     }
   }
-  Serial.printf("Found %d device(s)\n\n", count);
+  hal_printf("Found %d device(s)\n\n", count);
 }
 
 void setup() {
-  // Initialize Serial for debugging
-  Serial.begin(115200);
-  delay(1000);
-  Serial.println("\n\nStarting...");
+  // Console UART at CONSOLE_BAUD; `baud <rate>` raises it for bulk exports
+  console_begin();
+  hal_delay_ms(1000);
+  hal_printf("\n\nStarting...\n");
 
   // Initialize I2C
-  Wire.begin(I2C_SDA, I2C_SCL);
+  hal_i2c_begin(I2C_SDA, I2C_SCL, I2C_FREQ);
   
   // Scan I2C bus first
   scanI2C();
 
+  // Telemetry log in the history partition, early so boot events are kept
+  history_begin();
+
+  // Trial boot bookkeeping after a serial update, before anything can crash
+  ota_begin(boot_healthy);
+
   // Initialize OLED
-  if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR)) {
-    Serial.println("SSD1306 init failed");
+  if (!display.begin()) {
+    hal_printf("Display init failed\n");
     for (;;);
   }
   display.clearDisplay();
-  display.ssd1306_command(0x81);  // Set contrast control
-  display.ssd1306_command(50);   // Contrast value ~50% (default 207, range 0-255)
+  display.setContrast(50);   // Contrast value ~50% (default 207, range 0-255)
   display.setTextSize(1);
-  display.setTextColor(SSD1306_WHITE);
+  display.setTextColor(DISPLAY_WHITE);
   display.setCursor(0, 0);
   display.println("Initializing...");
   display.display();
+  console_register("display", "Show display frames and bytes sent", display_command);
 
-  // Initialize DHT20
-  Serial.println("Initializing DHT20 at 0x38...");
-  dht.begin();
-  delay(100);
+  // Initialize the humidity sensor (periodic drivers start measuring here)
+  hal_printf("Initializing %s...\n", HumiditySensor::name());
+  if (!sensor.begin()) {
+    hal_printf("%s not found\n", HumiditySensor::name());
+  }
+  hal_delay_ms(100);
 
   // Initialize water level sensor pin
-  pinMode(WATER_LEVEL_PIN, INPUT);
-  Serial.printf("Water level sensor initialized on GPIO%d\n", WATER_LEVEL_PIN);
+  hal_gpio_input(WATER_LEVEL_PIN);
+  hal_printf("Water level sensor initialized on GPIO%d\n", WATER_LEVEL_PIN);
+
+  // Valve, pump channels and their wear counters, KPIs, gain schedule
+  controller_begin();
 
-  // Initialize valve pin
-  pinMode(VALVE_PIN, OUTPUT);
-  digitalWrite(VALVE_PIN, LOW);
-  Serial.printf("Valve initialized on GPIO%d\n", VALVE_PIN);
+  // Task periods from NVS, checked against the CPU/I2C load model
+  periods_begin(I2C_FREQ);
 
-  // Initialize PWM for pump on GPIO25 (stopped initially)
-  ledcSetup(PWM_CHANNEL, PWM_FREQ, PWM_RESOLUTION);
-  ledcAttachPin(PUMP_PWM_PIN, PWM_CHANNEL);
-  ledcWrite(PWM_CHANNEL, 0);  // Start with pump off
-  Serial.printf("Pump PWM initialized on GPIO%d (stopped)\n", PUMP_PWM_PIN);
+  // Interlock supervisor on core 1, independent of the control task
+  safety_begin();
+
+  // Peripheral checks, in parallel within SELFTEST_BUDGET_MS
+  selftest_run(bootTests, sizeof(bootTests) / sizeof(bootTests[0]), SELFTEST_BUDGET_MS);
+
+  // Multi-unit coordination (COORD_UNIT_ID build flag, 0 = standalone)
+  coord_begin(COORD_UNIT_ID, (int16_t)lroundf(HUMIDITY_PRESET * 10));
 
   // Create FreeRTOS tasks
   xTaskCreatePinnedToCore(sensor_task, "SensorTask", 4096, NULL, 5, NULL, 0); // Core 0
   xTaskCreatePinnedToCore(water_level_task, "WaterLevelTask", 4096, NULL, 5, NULL, 0); // Core 0
   xTaskCreatePinnedToCore(control_task, "ControlTask", 4096, NULL, 5, NULL, 0); // Core 0
   xTaskCreatePinnedToCore(display_task, "DisplayTask", 4096, NULL, 5, NULL, 1); // Core 1
+  xTaskCreatePinnedToCore(history_task, "HistoryTask", 4096, NULL, 4, NULL, 1); // Core 1
+  xTaskCreatePinnedToCore(console_task, "ConsoleTask", 4096, NULL, 3, NULL, 1); // Core 1
+  if (COORD_UNIT_ID != 0) {
+    xTaskCreatePinnedToCore(coord_task, "CoordTask", 4096, NULL, 4, NULL, 1); // Core 1
+  }
+
+  // Boot cost and I2C overhead, for comparing the Arduino and ESP-IDF builds
+  I2cStats stats;
+  hal_i2c_get_stats(&stats);
+  int64_t bootMs = hal_micros() / 1000;
+  hal_printf("Setup done %lld ms after boot\n", (long long)bootMs);
+  history_log_event(EVENT_BOOT, selftest_passed() ? 1 : 0, (int32_t)bootMs, "boot");
+  hal_printf("I2C: %u transactions, %u errors, avg %u us, max %u us\n",
+             (unsigned)stats.transactions, (unsigned)stats.errors,
+             stats.transactions ? (unsigned)(stats.busyUs / stats.transactions) : 0u, (unsigned)stats.maxUs);
 }
 
 void loop() {
   // The loop function can remain empty because tasks are running in FreeRTOS
-}
\ No newline at end of file
+}
+
+#ifndef ARDUINO
+#include <nvs_flash.h>
+
+// Pure ESP-IDF entry point; app_main may return, the tasks keep running
+extern "C" void app_main() {
+  // The Arduino core does this in initArduino()
+  if (nvs_flash_init() != ESP_OK) {
+    nvs_flash_erase();
+    nvs_flash_init();
+  }
+  setup();
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_idf_version.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <esp32/rom/miniz.h>
+#include <mbedtls/sha256.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ota.h"
+#include "console.h"
+#include "hal.h"
+#include "history.h"
+
+#define OTA_NVS_NAMESPACE "ota"
+#define OTA_NVS_KEY "trial"
+#define OTA_READ_CHUNK 256
+#define OTA_TASK_STACK 3072
+
+// mbedtls 3 (IDF 5) dropped the _ret suffix that mbedtls 2.28 (IDF 4.4, Arduino core 2.x) uses
+#if ESP_IDF_VERSION_MAJOR >= 5
+#define ota_sha256_starts mbedtls_sha256_starts
+#define ota_sha256_update mbedtls_sha256_update
+#define ota_sha256_finish mbedtls_sha256_finish
+#else
+#define ota_sha256_starts mbedtls_sha256_starts_ret
+#define ota_sha256_update mbedtls_sha256_update_ret
+#define ota_sha256_finish mbedtls_sha256_finish_ret
+#endif
+
+// Kept in NVS while a new image is on trial
+struct OtaTrial {
+  uint32_t slot;       // Flash address of the trial image's partition
+  uint8_t bootsLeft;
+  uint8_t reserved[3];
+};
+
+// One update in progress, on the heap (~45 KB, mostly the inflate window)
+struct OtaUpdate {
+  const esp_partition_t *running;
+  const esp_partition_t *target;
+  esp_ota_handle_t handle;
+  bool started;
+  OtaPatchHeader header;
+  uint32_t headerGot;
+  mbedtls_sha256_context sha;
+  uint32_t written;
+
+  tinfl_decompressor inflator;
+  uint8_t dict[TINFL_LZ_DICT_SIZE];   // Circular inflate output window
+  size_t dictOfs;
+  bool inflateDone;
+
+  // Op stream
+  uint8_t opHeader[9];
+  uint8_t opHeaderLen;
+  uint8_t opHeaderGot;
+  uint8_t op;
+  uint32_t src;
+  uint32_t left;   // Body bytes still to come for the current op
+  bool ended;
+
+  uint8_t frame[OTA_FRAME_MAX];
+  uint8_t oldBytes[OTA_READ_CHUNK];
+};
+
+static OtaHealthFn healthFn = NULL;
+static bool onTrial = false;
+
+// Arduino core: skip its own rollback check in initArduino(), ota_begin() decides
+#ifdef ARDUINO
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+#endif
+
+static bool trial_load(OtaTrial *t) {
+  nvs_handle_t nvs;
+  if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return false;
+  }
+  size_t len = sizeof(*t);
+  bool ok = nvs_get_blob(nvs, OTA_NVS_KEY, t, &len) == ESP_OK && len == sizeof(*t);
+  nvs_close(nvs);
+  return ok;
+}
+
+static void trial_save(const OtaTrial *t) {
+  nvs_handle_t nvs;
+  if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  if (t != NULL) {
+    nvs_set_blob(nvs, OTA_NVS_KEY, t, sizeof(*t));
+  } else {
+    nvs_erase_key(nvs, OTA_NVS_KEY);
+  }
+  nvs_commit(nvs);
+  nvs_close(nvs);
+}
+
+static const char *ota_status_name(int32_t status) {
+  switch (status) {
+    case OTA_OK: return "ok";
+    case OTA_ERR_BUSY: return "busy";
+    case OTA_ERR_HEADER: return "bad header";
+    case OTA_ERR_BASE: return "patch is for a different image";
+    case OTA_ERR_SIZE: return "image does not fit";
+    case OTA_ERR_INFLATE: return "corrupt compressed data";
+    case OTA_ERR_PATCH: return "bad patch op";
+    case OTA_ERR_FLASH: return "flash write failed";
+    case OTA_ERR_VERIFY: return "verification failed";
+    case OTA_ERR_TIMEOUT: return "timeout";
+    default: return "bad frame";
+  }
+}
+
+// Update path: header -> inflate -> ops -> image writer
+
+static int32_t image_write(OtaUpdate *u, const uint8_t *data, size_t len) {
+  if (u->written + len > u->header.newSize) {
+    return OTA_ERR_SIZE;
+  }
+  if (esp_ota_write(u->handle, data, len) != ESP_OK) {
+    return OTA_ERR_FLASH;
+  }
+  ota_sha256_update(&u->sha, data, len);
+  u->written += len;
+  return OTA_OK;
+}
+
+static int32_t ops_feed(OtaUpdate *u, const uint8_t *p, size_t n) {
+  while (n > 0) {
+    if (u->ended) {
+      return OTA_ERR_PATCH;   // Data after END
+    }
+    if (u->left == 0) {
+      // Collect the next op header; ops may span inflate output chunks
+      if (u->opHeaderGot == 0) {
+        u->op = p[0];
+        u->opHeaderLen = u->op == OTA_OP_ADD ? 9 : u->op == OTA_OP_INSERT ? 5 : u->op == OTA_OP_END ? 1 : 0;
+        if (u->opHeaderLen == 0) {
+          return OTA_ERR_PATCH;
+        }
+      }
+      while (n > 0 && u->opHeaderGot < u->opHeaderLen) {
+        u->opHeader[u->opHeaderGot++] = *p++;
+        n--;
+      }
+      if (u->opHeaderGot < u->opHeaderLen) {
+        return OTA_OK;
+      }
+      u->opHeaderGot = 0;
+      if (u->op == OTA_OP_END) {
+        u->ended = true;
+      } else if (u->op == OTA_OP_ADD) {
+        memcpy(&u->src, u->opHeader + 1, 4);
+        memcpy(&u->left, u->opHeader + 5, 4);
+        if (u->src > u->header.oldSize || u->left > u->header.oldSize - u->src) {
+          return OTA_ERR_PATCH;
+        }
+      } else {
+        memcpy(&u->left, u->opHeader + 1, 4);
+      }
+      continue;
+    }
+
+    size_t k = n < u->left ? n : u->left;
+    if (k > OTA_READ_CHUNK) {
+      k = OTA_READ_CHUNK;
+    }
+    const uint8_t *out = p;
+    if (u->op == OTA_OP_ADD) {
+      // New bytes = running image + patch bytes; unchanged code is all zeros
+      // in the patch, which is what makes it compress so well
+      if (esp_partition_read(u->running, u->src, u->oldBytes, k) != ESP_OK) {
+        return OTA_ERR_FLASH;
+      }
+      for (size_t i = 0; i < k; i++) {
+        u->oldBytes[i] += p[i];
+      }
+      out = u->oldBytes;
+      u->src += k;
+    }
+    int32_t status = image_write(u, out, k);
+    if (status != OTA_OK) {
+      return status;
+    }
+    p += k;
+    n -= k;
+    u->left -= k;
+  }
+  return OTA_OK;
+}
+
+static int32_t inflate_feed(OtaUpdate *u, const uint8_t *in, size_t len) {
+  while (!u->inflateDone) {
+    size_t inBytes = len;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - u->dictOfs;
+    tinfl_status st = tinfl_decompress(&u->inflator, in, &inBytes, u->dict, u->dict + u->dictOfs, &outBytes,
+                                       TINFL_FLAG_HAS_MORE_INPUT);
+    in += inBytes;
+    len -= inBytes;
+    if (outBytes > 0) {
+      int32_t status = ops_feed(u, u->dict + u->dictOfs, outBytes);
+      if (status != OTA_OK) {
+        return status;
+      }
+      u->dictOfs = (u->dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+    if (st == TINFL_STATUS_DONE) {
+      u->inflateDone = true;
+    } else if (st < 0) {
+      return OTA_ERR_INFLATE;
+    } else if (st == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+      return OTA_OK;
+    }
+  }
+  return len == 0 ? OTA_OK : OTA_ERR_INFLATE;   // Nothing may follow the stream
+}
+
+// Checks the header and that the patch was made against the running image
+static int32_t header_done(OtaUpdate *u) {
+  const OtaPatchHeader &h = u->header;
+  if (h.magic != OTA_PATCH_MAGIC) {
+    return OTA_ERR_HEADER;
+  }
+  if (h.newSize == 0 || h.newSize > u->target->size || h.oldSize > u->running->size) {
+    return OTA_ERR_SIZE;
+  }
+  if (h.oldSize > 0) {
+    // The inflate window is free until the stream starts; use it for reading
+    uint8_t digest[32];
+    mbedtls_sha256_context base;
+    mbedtls_sha256_init(&base);
+    ota_sha256_starts(&base, 0);
+    for (uint32_t off = 0; off < h.oldSize; off += sizeof(u->dict)) {
+      uint32_t n = h.oldSize - off < sizeof(u->dict) ? h.oldSize - off : sizeof(u->dict);
+      if (esp_partition_read(u->running, off, u->dict, n) != ESP_OK) {
+        mbedtls_sha256_free(&base);
+        return OTA_ERR_FLASH;
+      }
+      ota_sha256_update(&base, u->dict, n);
+    }
+    ota_sha256_finish(&base, digest);
+    mbedtls_sha256_free(&base);
+    if (memcmp(digest, h.oldSha256, sizeof(digest)) != 0) {
+      return OTA_ERR_BASE;
+    }
+  }
+#if ESP_IDF_VERSION_MAJOR >= 5
+  // Sectors are erased as the writes reach them instead of all up front
+  esp_err_t err = esp_ota_begin(u->target, OTA_WITH_SEQUENTIAL_WRITES, &u->handle);
+#else
+  esp_err_t err = esp_ota_begin(u->target, h.newSize, &u->handle);
+#endif
+  if (err != ESP_OK) {
+    return OTA_ERR_FLASH;
+  }
+  u->started = true;
+  tinfl_init(&u->inflator);
+  return OTA_OK;
+}
+
+static int32_t update_feed(OtaUpdate *u, const uint8_t *data, size_t len) {
+  if (u->headerGot < sizeof(u->header)) {
+    size_t n = sizeof(u->header) - u->headerGot;
+    if (n > len) {
+      n = len;
+    }
+    memcpy((uint8_t *)&u->header + u->headerGot, data, n);
+    u->headerGot += n;
+    data += n;
+    len -= n;
+    if (u->headerGot < sizeof(u->header)) {
+      return OTA_OK;
+    }
+    int32_t status = header_done(u);
+    if (status != OTA_OK) {
+      return status;
+    }
+  }
+  return len > 0 ? inflate_feed(u, data, len) : OTA_OK;
+}
+
+static int32_t update_finish(OtaUpdate *u) {
+  if (!u->inflateDone || !u->ended || u->written != u->header.newSize) {
+    return OTA_ERR_PATCH;
+  }
+  uint8_t digest[32];
+  ota_sha256_finish(&u->sha, digest);
+  if (memcmp(digest, u->header.newSha256, sizeof(digest)) != 0) {
+    return OTA_ERR_VERIFY;
+  }
+  // Image header, segment checksums and the appended hash
+  u->started = false;
+  if (esp_ota_end(u->handle) != ESP_OK) {
+    return OTA_ERR_VERIFY;
+  }
+  if (esp_ota_set_boot_partition(u->target) != ESP_OK) {
+    return OTA_ERR_FLASH;
+  }
+  OtaTrial trial = {u->target->address, OTA_TRIAL_BOOTS, {0, 0, 0}};
+  trial_save(&trial);
+  return OTA_OK;
+}
+
+static void ota_ack(uint32_t received, int32_t status) {
+  uint8_t payload[8];
+  memcpy(payload, &received, 4);
+  memcpy(payload + 4, &status, 4);
+  console_send_frame(FRAME_OTA_ACK, payload, sizeof(payload));
+}
+
+// `ota begin <bytes>`: runs in the console task, which owns the console
+// input until the patch is in
+static void ota_receive(uint32_t total) {
+  const esp_partition_t *target = esp_ota_get_next_update_partition(NULL);
+  OtaUpdate *u = NULL;
+  int32_t status = OTA_OK;
+  if (onTrial || target == NULL) {
+    status = OTA_ERR_BUSY;   // Confirm (or roll back) the trial image first; no second slot
+  } else if ((u = (OtaUpdate *)calloc(1, sizeof(OtaUpdate))) == NULL) {
+    status = OTA_ERR_BUSY;
+  }
+
+  console_begin_binary();
+  ota_ack(0, status);
+  uint32_t received = 0;
+  int64_t start = hal_micros();
+  if (u != NULL) {
+    u->running = esp_ota_get_running_partition();
+    u->target = target;
+    mbedtls_sha256_init(&u->sha);
+    ota_sha256_starts(&u->sha, 0);
+    while (status == OTA_OK && received < total) {
+      uint8_t type;
+      int len = console_read_frame(&type, u->frame, sizeof(u->frame), OTA_FRAME_TIMEOUT_MS);
+      if (len < 0) {
+        status = OTA_ERR_TIMEOUT;
+      } else if (type != FRAME_OTA_DATA || received + len > total) {
+        status = OTA_ERR_FRAME;
+      } else {
+        status = update_feed(u, u->frame, len);
+        received += len;
+      }
+      ota_ack(received, status);
+    }
+    if (status == OTA_OK) {
+      status = update_finish(u);
+      ota_ack(received, status);
+    }
+    if (u->started) {
+      esp_ota_abort(u->handle);
+    }
+    mbedtls_sha256_free(&u->sha);
+  }
+  console_end_binary();
+
+  uint32_t ms = (uint32_t)((hal_micros() - start) / 1000);
+  if (status != OTA_OK) {
+    hal_printf("Update failed after %u of %u bytes: %s\n", (unsigned)received, (unsigned)total,
+               ota_status_name(status));
+    history_log_event(EVENT_OTA, OTA_EVENT_FAILED, status, target ? target->label : "");
+    free(u);
+    return;
+  }
+  hal_printf("Update: %u patch bytes -> %u byte image in %s, %u ms; rebooting\n", (unsigned)total,
+             (unsigned)u->header.newSize, target->label, (unsigned)ms);
+  history_log_event(EVENT_OTA, OTA_EVENT_WRITTEN, (int32_t)u->header.newSize, target->label);
+  free(u);
+  hal_console_flush(1000);
+  esp_restart();
+}
+
+// Trial handling
+
+static void ota_rollback(const char *reason) {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  hal_printf("Rolling back from %s: %s\n", running->label, reason);
+  history_log_event(EVENT_OTA, OTA_EVENT_ROLLBACK, 0, running->label);
+  trial_save(NULL);
+  hal_console_flush(1000);
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_invalid_rollback_and_reboot();   // Returns only if there is nothing to go back to
+  }
+  // Bootloader without rollback support: switch slots ourselves
+  const esp_partition_t *previous = esp_ota_get_next_update_partition(NULL);
+  if (previous != NULL && esp_ota_set_boot_partition(previous) == ESP_OK) {
+    esp_restart();
+  }
+  hal_printf("No previous image to roll back to\n");
+}
+
+static void ota_health_task(void *pvParameters) {
+  vTaskDelay(pdMS_TO_TICKS(OTA_HEALTH_S * 1000));
+  if (healthFn != NULL && !healthFn()) {
+    ota_rollback("health check failed");
+  } else {
+    esp_ota_mark_app_valid_cancel_rollback();
+    trial_save(NULL);
+    onTrial = false;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    hal_printf("Image in %s confirmed\n", running->label);
+    history_log_event(EVENT_OTA, OTA_EVENT_CONFIRMED, 0, running->label);
+  }
+  vTaskDelete(NULL);
+}
+
+static void ota_status() {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  const esp_partition_t *other = esp_ota_get_next_update_partition(NULL);
+  esp_app_desc_t desc;
+  if (esp_ota_get_partition_description(running, &desc) == ESP_OK) {
+    hal_printf("Running %s: %s %s, built %s %s%s\n", running->label, desc.project_name, desc.version, desc.date,
+               desc.time, onTrial ? " (on trial)" : "");
+  }
+  if (other == NULL) {
+    hal_printf("No second OTA slot in the partition table\n");
+  } else if (esp_ota_get_partition_description(other, &desc) == ESP_OK) {
+    hal_printf("Other slot %s: %s %s, built %s %s\n", other->label, desc.project_name, desc.version, desc.date,
+               desc.time);
+  } else {
+    hal_printf("Other slot %s: empty\n", other->label);
+  }
+}
+
+static void ota_command(int argc, char **argv) {
+  if (argc >= 3 && strcmp(argv[1], "begin") == 0) {
+    ota_receive(strtoul(argv[2], NULL, 10));
+  } else if (argc >= 2 && strcmp(argv[1], "rollback") == 0) {
+    ota_rollback("requested");
+  } else {
+    ota_status();
+  }
+}
+
+void ota_begin(OtaHealthFn healthy) {
+  healthFn = healthy;
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+  esp_ota_get_state_partition(running, &state);
+
+  OtaTrial trial;
+  bool haveTrial = trial_load(&trial);
+  if (haveTrial && trial.slot != running->address) {
+    // The bootloader went back to the previous image after a trial reset
+    hal_printf("Update did not boot, running %s again\n", running->label);
+    history_log_event(EVENT_OTA, OTA_EVENT_ROLLED_BACK, 0, running->label);
+    trial_save(NULL);
+    haveTrial = false;
+  }
+
+  onTrial = state == ESP_OTA_IMG_PENDING_VERIFY || haveTrial;
+  if (onTrial) {
+    // Counted before anything else can crash, so a reset loop ends here
+    if (haveTrial && trial.bootsLeft == 0) {
+      ota_rollback("reset before confirming");
+    } else if (haveTrial) {
+      trial.bootsLeft--;
+      trial_save(&trial);
+    }
+    hal_printf("Trial boot of %s, confirming after %d s\n", running->label, OTA_HEALTH_S);
+    history_log_event(EVENT_OTA, OTA_EVENT_TRIAL, haveTrial ? trial.bootsLeft : 0, running->label);
+    xTaskCreatePinnedToCore(ota_health_task, "OtaHealth", OTA_TASK_STACK, NULL, 2, NULL, 1);
+  }
+  console_register("ota", "Firmware slots; 'ota begin <bytes>' receives a patch (tools/fw_delta.py)", ota_command);
+}
+
+bool ota_on_trial() {
+  return onTrial;
+}
@@ -0,0 +1,47 @@
+#include "display_panels.h"
+#include "hal.h"
+
+#define SH1106_COLUMN_OFFSET 2  // 132-column RAM, the 128 visible ones are centred
+
+bool Sh1106Panel::begin() {
+  if (!hal_i2c_probe(i2caddr)) {
+    return false;
+  }
+  const uint8_t init[] = {
+    0xAE,                          // Display off
+    0xD5, 0x80,                    // Clock divide ratio
+    0xA8, (uint8_t)(h - 1),        // Multiplex ratio
+    0xD3, 0x00,                    // Display offset
+    0x40,                          // Start line 0
+    0xAD, 0x8B,                    // DC-DC converter on
+    0xA1,                          // Segment remap
+    0xC8,                          // COM scan direction: remapped
+    0xDA, 0x12,                    // COM pins
+    0x81, 0xCF,                    // Contrast
+    0xD9, 0x1F,                    // Precharge
+    0xDB, 0x40,                    // VCOM deselect level
+    0x32,                          // Pump voltage 8.0 V
+    0xA4,                          // Resume to RAM content
+    0xA6,                          // Normal (not inverted)
+    0xAF,                          // Display on
+  };
+  commandList(init, sizeof(init));
+  return true;
+}
+
+// The SH1106 has no window addressing, so each dirty page gets its own
+// page/column address and only its changed span is sent
+void Sh1106Panel::flush(const uint8_t *fb, const DisplayDirty &dirty) {
+  for (int p = 0; p < dirty.pages; p++) {
+    int x0 = dirty.x0[p];
+    int x1 = dirty.x1[p];
+    if (x0 > x1) {
+      continue;
+    }
+    int col = x0 + SH1106_COLUMN_OFFSET;
+    const uint8_t addr[] = {(uint8_t)(0xB0 | p), (uint8_t)(col & 0x0F), (uint8_t)(0x10 | (col >> 4))};
+    commandList(addr, sizeof(addr));
+    sendData(fb + p * w + x0, x1 - x0 + 1);
+    sendData(nullptr, 0);
+  }
+}
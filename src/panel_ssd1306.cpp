@@ -0,0 +1,103 @@
+#include <string.h>
+#include "display_panels.h"
+#include "hal.h"
+
+#define SSD1306_CTRL_CMD 0x00
+#define SSD1306_CTRL_DATA 0x40
+
+// Data bytes are collected across pages so a frame takes as few I2C
+// transactions as the backend allows; each one pays address + control byte
+static uint8_t dataBuf[HAL_I2C_MAX_WRITE];  // Only used from one task at a time
+static int dataLen = 0;
+
+bool Ssd1306Panel::begin() {
+  if (!hal_i2c_probe(i2caddr)) {
+    return false;
+  }
+  const uint8_t init[] = {
+    0xAE,                          // Display off
+    0xD5, 0x80,                    // Clock divide ratio
+    0xA8, (uint8_t)(h - 1),        // Multiplex ratio
+    0xD3, 0x00,                    // Display offset
+    0x40,                          // Start line 0
+    0x8D, 0x14,                    // Charge pump on (internal VCC)
+    0x20, 0x00,                    // Horizontal addressing mode
+    0xA1,                          // Segment remap
+    0xC8,                          // COM scan direction: remapped
+    0xDA, (uint8_t)(h == 64 ? 0x12 : 0x02),  // COM pins
+    0x81, 0xCF,                    // Contrast
+    0xD9, 0xF1,                    // Precharge
+    0xDB, 0x40,                    // VCOMH deselect level
+    0xA4,                          // Resume to RAM content
+    0xA6,                          // Normal (not inverted)
+    0x2E,                          // Deactivate scroll
+    0xAF,                          // Display on
+  };
+  commandList(init, sizeof(init));
+  return true;
+}
+
+void Ssd1306Panel::setContrast(uint8_t level) {
+  const uint8_t cmd[] = {0x81, level};
+  commandList(cmd, sizeof(cmd));
+}
+
+void Ssd1306Panel::commandList(const uint8_t *cmds, int n) {
+  uint8_t buf[32];
+  buf[0] = SSD1306_CTRL_CMD;
+  while (n > 0) {
+    int chunk = n < (int)sizeof(buf) - 1 ? n : (int)sizeof(buf) - 1;
+    memcpy(buf + 1, cmds, chunk);
+    hal_i2c_write(i2caddr, buf, chunk + 1);
+    cmds += chunk;
+    n -= chunk;
+  }
+}
+
+// Queues display data; n == 0 flushes what is pending
+void Ssd1306Panel::sendData(const uint8_t *data, int n) {
+  if (n == 0 && dataLen > 0) {
+    dataBuf[0] = SSD1306_CTRL_DATA;
+    hal_i2c_write(i2caddr, dataBuf, dataLen + 1);
+    sent += dataLen;
+    dataLen = 0;
+  }
+  while (n > 0) {
+    int room = HAL_I2C_MAX_WRITE - 1 - dataLen;
+    int chunk = n < room ? n : room;
+    memcpy(dataBuf + 1 + dataLen, data, chunk);
+    dataLen += chunk;
+    data += chunk;
+    n -= chunk;
+    if (dataLen == HAL_I2C_MAX_WRITE - 1) {
+      sendData(nullptr, 0);
+    }
+  }
+}
+
+// One address window around all dirty pages; horizontal addressing mode
+// wraps from x1 back to x0 on the next page
+void Ssd1306Panel::flush(const uint8_t *fb, const DisplayDirty &dirty) {
+  int p0 = -1, p1 = -1, x0 = w, x1 = -1;
+  for (int p = 0; p < dirty.pages; p++) {
+    if (dirty.x0[p] > dirty.x1[p]) {
+      continue;
+    }
+    if (p0 < 0) {
+      p0 = p;
+    }
+    p1 = p;
+    x0 = dirty.x0[p] < x0 ? dirty.x0[p] : x0;
+    x1 = dirty.x1[p] > x1 ? dirty.x1[p] : x1;
+  }
+  if (p0 < 0) {
+    return;
+  }
+
+  const uint8_t window[] = {0x21, (uint8_t)x0, (uint8_t)x1, 0x22, (uint8_t)p0, (uint8_t)p1};
+  commandList(window, sizeof(window));
+  for (int p = p0; p <= p1; p++) {
+    sendData(fb + p * w + x0, x1 - x0 + 1);
+  }
+  sendData(nullptr, 0);
+}
@@ -0,0 +1,131 @@
+#include "display_panels.h"
+#include "hal.h"
+
+#define SSD1322_COLUMN_OFFSET 0x1C  // 256-px panels start at RAM column 28 (4 px per column)
+
+// One page (8 rows) of expanded 4bpp data for the widest supported panel
+static uint8_t bandBuf[8 * 256 / 2];
+
+bool Ssd1322Panel::begin() {
+  hal_gpio_output(SSD1322_DC_PIN, LOW);
+  hal_gpio_output(SSD1322_RST_PIN, LOW);
+  hal_delay_ms(1);
+  hal_gpio_write(SSD1322_RST_PIN, HIGH);
+  hal_delay_ms(2);
+  if (!hal_spi_begin(SSD1322_SCK_PIN, SSD1322_MOSI_PIN, SSD1322_CS_PIN, SSD1322_SPI_HZ)) {
+    return false;
+  }
+
+  const uint8_t unlock[] = {0x12};
+  const uint8_t clock[] = {0x91};
+  const uint8_t mux[] = {(uint8_t)(h - 1)};
+  const uint8_t zero[] = {0x00};
+  const uint8_t remap[] = {0x14, 0x11};  // Horizontal increment, nibble remap, dual COM
+  const uint8_t vdd[] = {0x01};
+  const uint8_t enhanceA[] = {0xA0, 0xFD};
+  const uint8_t current[] = {0x0F};
+  const uint8_t phase[] = {0xE2};
+  const uint8_t enhanceB[] = {0x82, 0x20};
+  const uint8_t precharge[] = {0x1F};
+  const uint8_t precharge2[] = {0x08};
+  const uint8_t vcomh[] = {0x07};
+
+  command(0xFD, unlock, 1);
+  command(0xAE);                       // Display off
+  command(0xB3, clock, 1);
+  command(0xCA, mux, 1);
+  command(0xA2, zero, 1);              // Display offset
+  command(0xA1, zero, 1);              // Start line
+  command(0xA0, remap, 2);
+  command(0xB5, zero, 1);              // GPIO off
+  command(0xAB, vdd, 1);               // Internal VDD regulator
+  command(0xB4, enhanceA, 2);
+  command(0xC7, current, 1);           // Master current
+  command(0xB9);                       // Default linear gray table
+  command(0xB1, phase, 1);
+  command(0xD1, enhanceB, 2);
+  command(0xBB, precharge, 1);
+  command(0xB6, precharge2, 1);
+  command(0xBE, vcomh, 1);
+  command(0xA6);                       // Normal display
+  command(0xA9);                       // Exit partial display
+  setContrast(0x9F);
+  setForeground(15);
+  command(0xAF);                       // Display on
+  return true;
+}
+
+// Command byte with DC low, its parameters with DC high
+void Ssd1322Panel::command(uint8_t cmd, const uint8_t *args, int n) {
+  hal_gpio_write(SSD1322_DC_PIN, LOW);
+  hal_spi_write(&cmd, 1);
+  if (n > 0) {
+    hal_gpio_write(SSD1322_DC_PIN, HIGH);
+    hal_spi_write(args, n);
+  }
+}
+
+void Ssd1322Panel::setContrast(uint8_t level) {
+  command(0xC1, &level, 1);
+}
+
+void Ssd1322Panel::setForeground(uint8_t level) {
+  level &= 0x0F;
+  // Index bit 0 = left pixel (high nibble), bit 1 = right pixel
+  lut[0] = 0x00;
+  lut[1] = (uint8_t)(level << 4);
+  lut[2] = level;
+  lut[3] = (uint8_t)((level << 4) | level);
+}
+
+// Sends pages p0..p1, columns x0..x1 (multiples of 4 px). The 1bpp canvas is
+// expanded one page at a time: each pair of column bytes yields one 4bpp byte
+// for each of the page's 8 rows, via the 2-pixel lookup table.
+void Ssd1322Panel::sendBand(const uint8_t *fb, int page0, int page1, int x0, int x1) {
+  const uint8_t cols[] = {(uint8_t)(SSD1322_COLUMN_OFFSET + x0 / 4), (uint8_t)(SSD1322_COLUMN_OFFSET + x1 / 4)};
+  const uint8_t rows[] = {(uint8_t)(page0 * 8), (uint8_t)(page1 * 8 + 7)};
+  command(0x15, cols, 2);
+  command(0x75, rows, 2);
+  command(0x5C);  // Write RAM
+  hal_gpio_write(SSD1322_DC_PIN, HIGH);
+
+  int span = (x1 - x0 + 1) / 2;  // Bytes per row
+  for (int p = page0; p <= page1; p++) {
+    const uint8_t *src = fb + p * w + x0;
+    for (int i = 0; i < span; i++) {
+      uint8_t a = src[2 * i];
+      uint8_t b = src[2 * i + 1];
+      if ((a | b) == 0) {
+        for (int r = 0; r < 8; r++) {
+          bandBuf[r * span + i] = 0;
+        }
+        continue;
+      }
+      for (int r = 0; r < 8; r++) {
+        bandBuf[r * span + i] = lut[((a >> r) & 1) | (((b >> r) & 1) << 1)];
+      }
+    }
+    hal_spi_write(bandBuf, 8 * span);
+    sent += 8 * span;
+  }
+}
+
+// Consecutive dirty pages are merged into one band with their combined columns
+void Ssd1322Panel::flush(const uint8_t *fb, const DisplayDirty &dirty) {
+  int p = 0;
+  while (p < dirty.pages) {
+    if (dirty.x0[p] > dirty.x1[p]) {
+      p++;
+      continue;
+    }
+    int p0 = p;
+    int x0 = dirty.x0[p], x1 = dirty.x1[p];
+    while (p + 1 < dirty.pages && dirty.x0[p + 1] <= dirty.x1[p + 1]) {
+      p++;
+      x0 = dirty.x0[p] < x0 ? dirty.x0[p] : x0;
+      x1 = dirty.x1[p] > x1 ? dirty.x1[p] : x1;
+    }
+    sendBand(fb, p0, p, x0 & ~3, x1 | 3);
+    p++;
+  }
+}
@@ -0,0 +1,175 @@
+#include <freertos/FreeRTOS.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+#include "periods.h"
+#include "display_panels.h"
+#include "sensor_drivers.h"
+#include "console.h"
+#include "hal.h"
+
+#define PERIODS_NVS_NAMESPACE "periods"
+#define PERIODS_NVS_KEY "ms"
+
+// Full 128x64 frame plus page/column commands; the data goes out in chunks of
+// HAL_I2C_MAX_WRITE - 1 after the control byte. The SSD1322 is on SPI.
+#if DISPLAY_PANEL == PANEL_SSD1322
+#define DISPLAY_I2C_BYTES 0
+#define DISPLAY_I2C_TRANSACTIONS 0
+#define DISPLAY_CPU_US 6000
+#else
+#define DISPLAY_I2C_BYTES (128 * 64 / 8 + 32)
+#define DISPLAY_I2C_TRANSACTIONS (128 * 64 / 8 / (HAL_I2C_MAX_WRITE - 1) + 9)
+#define DISPLAY_CPU_US 4000
+#endif
+
+// Estimated from the code paths: sensor bytes come from the driver,
+// display = render, diff against the shadow buffer and a worst-case full
+// redraw (the scrolling text touches every line)
+const JobCost jobCosts[PERIOD_COUNT] = {
+  {"sensor", 0, 400, HumiditySensor::I2C_BYTES, HumiditySensor::I2C_TRANSACTIONS},
+  {"level", 0, 20, 0, 0},
+  {"control", 0, 300, 0, 0},
+  {"display", 1, DISPLAY_CPU_US, DISPLAY_I2C_BYTES, DISPLAY_I2C_TRANSACTIONS},
+};
+
+static const uint32_t periodMin[PERIOD_COUNT] = PERIOD_MIN_MS;
+static const uint32_t periodDefault[PERIOD_COUNT] = PERIOD_DEFAULTS;
+
+static uint32_t periods[PERIOD_COUNT] = PERIOD_DEFAULTS;
+static uint32_t busHz = 100000;
+static portMUX_TYPE periodsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void load_estimate(const JobCost *jobs, const uint32_t *ms, uint32_t i2cHz, LoadEstimate *out) {
+  uint32_t cpu[2] = {0, 0};
+  uint32_t i2c = 0;
+  for (int i = 0; i < PERIOD_COUNT; i++) {
+    const JobCost &j = jobs[i];
+    // Every byte is 8 bits + ACK
+    uint32_t bits = (j.i2cBytes + j.i2cTransactions) * 9 + j.i2cTransactions * LOAD_I2C_TXN_BITS;
+    uint32_t busUs = (uint32_t)((uint64_t)bits * 1000000 / i2cHz);
+    // us per ms is permille; summed in 1/1000 permille so small jobs count
+    cpu[j.core & 1] += j.cpuUs * 1000 / ms[i];
+    i2c += busUs * 1000 / ms[i];
+  }
+  cpu[0] /= 1000;
+  cpu[1] /= 1000;
+  i2c /= 1000;
+  out->cpuPermille[0] = cpu[0] > 0xFFFF ? 0xFFFF : (uint16_t)cpu[0];
+  out->cpuPermille[1] = cpu[1] > 0xFFFF ? 0xFFFF : (uint16_t)cpu[1];
+  out->i2cPermille = i2c > 0xFFFF ? 0xFFFF : (uint16_t)i2c;
+}
+
+// Range and budget check; prints why a set is refused
+static bool periods_check(const uint32_t *ms, bool verbose) {
+  for (int i = 0; i < PERIOD_COUNT; i++) {
+    if (ms[i] < periodMin[i] || ms[i] > PERIOD_MAX_MS) {
+      if (verbose) {
+        hal_printf("%s period must be %u..%u ms\n", jobCosts[i].name, (unsigned)periodMin[i], PERIOD_MAX_MS);
+      }
+      return false;
+    }
+  }
+  LoadEstimate est;
+  load_estimate(jobCosts, ms, busHz, &est);
+  if (est.i2cPermille > LOAD_I2C_MAX_PERMILLE) {
+    if (verbose) {
+      hal_printf("Refused: I2C bus at %u.%u%% (limit %u%%)\n", est.i2cPermille / 10, est.i2cPermille % 10,
+                 LOAD_I2C_MAX_PERMILLE / 10);
+    }
+    return false;
+  }
+  for (int core = 0; core < 2; core++) {
+    if (est.cpuPermille[core] > LOAD_CPU_MAX_PERMILLE) {
+      if (verbose) {
+        hal_printf("Refused: core %d at %u.%u%% (limit %u%%)\n", core, est.cpuPermille[core] / 10,
+                   est.cpuPermille[core] % 10, LOAD_CPU_MAX_PERMILLE / 10);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+static void periods_save() {
+  nvs_handle_t nvs;
+  if (nvs_open(PERIODS_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  nvs_set_blob(nvs, PERIODS_NVS_KEY, periods, sizeof(periods));
+  nvs_commit(nvs);
+  nvs_close(nvs);
+}
+
+uint32_t period_ms(PeriodId id) {
+  return periods[id];
+}
+
+bool period_set(PeriodId id, uint32_t ms) {
+  uint32_t next[PERIOD_COUNT];
+  portENTER_CRITICAL(&periodsMux);
+  memcpy(next, periods, sizeof(next));
+  portEXIT_CRITICAL(&periodsMux);
+  next[id] = ms;
+  if (!periods_check(next, true)) {
+    return false;
+  }
+  portENTER_CRITICAL(&periodsMux);
+  periods[id] = ms;
+  portEXIT_CRITICAL(&periodsMux);
+  periods_save();
+  return true;
+}
+
+static void periods_command(int argc, char **argv) {
+  if (argc >= 3) {
+    for (int i = 0; i < PERIOD_COUNT; i++) {
+      if (strcmp(argv[1], jobCosts[i].name) == 0) {
+        if (period_set((PeriodId)i, strtoul(argv[2], NULL, 10))) {
+          hal_printf("%s period now %u ms\n", jobCosts[i].name, (unsigned)period_ms((PeriodId)i));
+        }
+        return;
+      }
+    }
+    hal_printf("Unknown task '%s'\n", argv[1]);
+    return;
+  }
+
+  for (int i = 0; i < PERIOD_COUNT; i++) {
+    const JobCost &j = jobCosts[i];
+    hal_printf("  %-8s %5u ms  core %u  %5u us  %4u I2C bytes\n", j.name, (unsigned)periods[i], j.core,
+               j.cpuUs, j.i2cBytes);
+  }
+  LoadEstimate est;
+  load_estimate(jobCosts, periods, busHz, &est);
+  hal_printf("Model: core 0 %u.%u%%, core 1 %u.%u%%, I2C %u.%u%% at %u kHz (limit %u%%)\n",
+             est.cpuPermille[0] / 10, est.cpuPermille[0] % 10, est.cpuPermille[1] / 10, est.cpuPermille[1] % 10,
+             est.i2cPermille / 10, est.i2cPermille % 10, (unsigned)(busHz / 1000), LOAD_I2C_MAX_PERMILLE / 10);
+
+  // Measured bus occupancy since boot, to keep the model honest
+  I2cStats stats;
+  hal_i2c_get_stats(&stats);
+  uint64_t upUs = (uint64_t)hal_micros();
+  unsigned measured = upUs ? (unsigned)(stats.busyUs * 1000 / upUs) : 0;
+  hal_printf("Measured: I2C busy %u.%u%% since boot\n", measured / 10, measured % 10);
+  hal_printf("Usage: periods <task> <ms>\n");
+}
+
+void periods_begin(uint32_t i2cHz) {
+  busHz = i2cHz;
+  nvs_handle_t nvs;
+  if (nvs_open(PERIODS_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+    uint32_t saved[PERIOD_COUNT];
+    size_t len = sizeof(saved);
+    // Saved periods from an older build, or over budget at this bus speed, are dropped
+    if (nvs_get_blob(nvs, PERIODS_NVS_KEY, saved, &len) == ESP_OK && len == sizeof(saved) &&
+        periods_check(saved, false)) {
+      memcpy(periods, saved, sizeof(periods));
+    }
+    nvs_close(nvs);
+  }
+  if (!periods_check(periods, true)) {
+    memcpy(periods, periodDefault, sizeof(periods));
+  }
+  console_register("periods", "Show or set task periods (periods <task> <ms>) and the load model", periods_command);
+}
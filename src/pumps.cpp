@@ -0,0 +1,186 @@
+#include <freertos/FreeRTOS.h>
+#include <nvs.h>
+#include <string.h>
+#include "pumps.h"
+#include "console.h"
+#include "hal.h"
+
+#define PUMPS_NVS_NAMESPACE "pumps"
+#define PUMPS_NVS_KEY "wear"
+
+static const int pumpPins[PUMP_MAX_CHANNELS] = PUMP_PINS;
+static const int pumpPwm[PUMP_MAX_CHANNELS] = PUMP_PWM_CHANNELS;
+
+static PumpWear wear[PUMP_CHANNELS];
+static bool running[PUMP_CHANNELS];
+static uint32_t startedMs[PUMP_CHANNELS];
+static int leadChannel = 0;
+static uint32_t lastSaveMs = 0;
+static portMUX_TYPE pumpsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static_assert(PUMP_CHANNELS >= 1 && PUMP_CHANNELS <= PUMP_MAX_CHANNELS, "PUMP_CHANNELS out of range");
+
+static uint32_t wear_score(int ch) {
+  return wear[ch].runtimeS + wear[ch].starts * PUMP_START_WEAR_S;
+}
+
+static void pumps_save() {
+  nvs_handle_t nvs;
+  if (nvs_open(PUMPS_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  nvs_set_blob(nvs, PUMPS_NVS_KEY, wear, sizeof(wear));
+  nvs_commit(nvs);
+  nvs_close(nvs);
+  lastSaveMs = hal_millis();
+}
+
+static void pumps_load() {
+  nvs_handle_t nvs;
+  if (nvs_open(PUMPS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return;
+  }
+  // A blob from a build with a different channel count is ignored
+  size_t len = sizeof(wear);
+  if (nvs_get_blob(nvs, PUMPS_NVS_KEY, wear, &len) != ESP_OK || len != sizeof(wear)) {
+    memset(wear, 0, sizeof(wear));
+  }
+  nvs_close(nvs);
+}
+
+// Keeps the current lead unless another channel is clearly less worn
+static void pumps_pick_lead() {
+  int best = leadChannel;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    if (wear_score(ch) < wear_score(best)) {
+      best = ch;
+    }
+  }
+  if (best != leadChannel && wear_score(leadChannel) - wear_score(best) > PUMP_ROTATE_MARGIN_S) {
+    hal_printf("Lead pump now #%d (was #%d)\n", best + 1, leadChannel + 1);
+    leadChannel = best;
+  }
+}
+
+void pumps_start(int count) {
+  if (count > PUMP_CHANNELS) {
+    count = PUMP_CHANNELS;
+  }
+  pumps_pick_lead();
+
+  // Lead first, then the lag pumps from least to most worn
+  int order[PUMP_CHANNELS];
+  int n = 0;
+  order[n++] = leadChannel;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    if (ch == leadChannel) {
+      continue;
+    }
+    int pos = n++;
+    while (pos > 1 && wear_score(order[pos - 1]) > wear_score(ch)) {
+      order[pos] = order[pos - 1];
+      pos--;
+    }
+    order[pos] = ch;
+  }
+
+  for (int i = 0; i < count; i++) {
+    int ch = order[i];
+    if (running[ch]) {
+      continue;
+    }
+    hal_pwm_write(pumpPwm[ch], PWM_DUTY_85);
+    portENTER_CRITICAL(&pumpsMux);
+    running[ch] = true;
+    startedMs[ch] = hal_millis();
+    wear[ch].starts++;
+    portEXIT_CRITICAL(&pumpsMux);
+  }
+}
+
+void pumps_stop_all() {
+  bool any = false;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    hal_pwm_write(pumpPwm[ch], 0);
+    if (!running[ch]) {
+      continue;
+    }
+    portENTER_CRITICAL(&pumpsMux);
+    running[ch] = false;
+    wear[ch].runtimeS += (hal_millis() - startedMs[ch] + 500) / 1000;
+    portEXIT_CRITICAL(&pumpsMux);
+    any = true;
+  }
+  if (any && hal_millis() - lastSaveMs >= PUMP_SAVE_PERIOD_MS) {
+    pumps_save();
+  }
+}
+
+int pumps_running() {
+  int n = 0;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    n += running[ch] ? 1 : 0;
+  }
+  return n;
+}
+
+int pumps_needed(float deficit, float lagDeficit) {
+  int n = 1 + (deficit > 0 && lagDeficit > 0 ? (int)(deficit / lagDeficit) : 0);
+  return n < PUMP_CHANNELS ? n : PUMP_CHANNELS;
+}
+
+// Runtime includes the part of the current run that has not been booked yet
+void pumps_get_wear(int channel, PumpWear *out) {
+  portENTER_CRITICAL(&pumpsMux);
+  *out = wear[channel];
+  if (running[channel]) {
+    out->runtimeS += (hal_millis() - startedMs[channel]) / 1000;
+  }
+  portEXIT_CRITICAL(&pumpsMux);
+}
+
+uint32_t pumps_total_runtime() {
+  uint32_t total = 0;
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    PumpWear w;
+    pumps_get_wear(ch, &w);
+    total += w.runtimeS;
+  }
+  return total;
+}
+
+uint32_t pumps_total_starts() {
+  uint32_t total = 0;
+  portENTER_CRITICAL(&pumpsMux);
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    total += wear[ch].starts;
+  }
+  portEXIT_CRITICAL(&pumpsMux);
+  return total;
+}
+
+static void pumps_command(int argc, char **argv) {
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    PumpWear w;
+    pumps_get_wear(ch, &w);
+    hal_printf("  #%d GPIO%-2d %-4s %-3s runtime %u.%uh starts %u\n", ch + 1, pumpPins[ch],
+               ch == leadChannel ? "lead" : "lag", running[ch] ? "ON" : "off", (unsigned)(w.runtimeS / 3600),
+               (unsigned)(w.runtimeS % 3600 / 360), (unsigned)w.starts);
+  }
+}
+
+void pumps_begin() {
+  pumps_load();
+  for (int ch = 0; ch < PUMP_CHANNELS; ch++) {
+    hal_pwm_init(pumpPins[ch], pumpPwm[ch], PWM_FREQ, PWM_RESOLUTION);  // Starts with pump off
+    hal_printf("Pump #%d PWM initialized on GPIO%d (stopped)\n", ch + 1, pumpPins[ch]);
+  }
+  leadChannel = 0;
+  for (int ch = 1; ch < PUMP_CHANNELS; ch++) {
+    if (wear_score(ch) < wear_score(leadChannel)) {
+      leadChannel = ch;
+    }
+  }
+  lastSaveMs = hal_millis();
+  console_register("pumps", "Show per-pump runtime, starts and lead/lag role", pumps_command);
+}
@@ -0,0 +1,115 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <stdint.h>
+#include "selftest.h"
+#include "history.h"
+#include "hal.h"
+
+static const SelfTest *tests;
+static SelfTestReport reports[SELFTEST_MAX];
+static bool finished[SELFTEST_MAX];
+static bool closed = false;      // Set at the deadline; late results are dropped
+static bool passed = false;
+static SemaphoreHandle_t doneSem = NULL;
+static SemaphoreHandle_t exitSem = NULL;   // Given by every check task as it ends, late or not
+static portMUX_TYPE selftestMux = portMUX_INITIALIZER_UNLOCKED;
+
+const char *selftest_result_name(SelfTestResult r) {
+  switch (r) {
+    case SELFTEST_PASS: return "PASS";
+    case SELFTEST_FAIL: return "FAIL";
+    case SELFTEST_TIMEOUT: return "TIMEOUT";
+    default: return "SKIP";
+  }
+}
+
+static void selftest_task(void *arg) {
+  int i = (int)(intptr_t)arg;
+  int64_t start = hal_micros();
+  int32_t detail = 0;
+  SelfTestResult result = tests[i].fn(&detail);
+  uint32_t ms = (uint32_t)((hal_micros() - start) / 1000);
+
+  portENTER_CRITICAL(&selftestMux);
+  bool late = closed;
+  if (!late) {
+    reports[i].result = result;
+    reports[i].detail = detail;
+    reports[i].ms = ms;
+    finished[i] = true;
+  }
+  portEXIT_CRITICAL(&selftestMux);
+  if (!late) {
+    xSemaphoreGive(doneSem);
+  }
+  xSemaphoreGive(exitSem);
+  vTaskDelete(NULL);
+}
+
+bool selftest_run(const SelfTest *list, int n, uint32_t budgetMs) {
+  if (n > SELFTEST_MAX) {
+    n = SELFTEST_MAX;
+  }
+  if (doneSem == NULL) {
+    doneSem = xSemaphoreCreateCounting(SELFTEST_MAX, 0);
+    exitSem = xSemaphoreCreateCounting(SELFTEST_MAX, 0);
+  }
+  tests = list;
+  closed = false;
+  for (int i = 0; i < n; i++) {
+    finished[i] = false;
+  }
+
+  // Spread the checks over both cores; they mostly sleep on I2C or delays
+  int64_t start = hal_micros();
+  for (int i = 0; i < n; i++) {
+    xTaskCreatePinnedToCore(selftest_task, "SelfTest", SELFTEST_STACK, (void *)(intptr_t)i, 5, NULL, i % 2);
+  }
+
+  int done = 0;
+  while (done < n) {
+    int64_t leftMs = (int64_t)budgetMs - (hal_micros() - start) / 1000;
+    if (leftMs <= 0 || xSemaphoreTake(doneSem, pdMS_TO_TICKS(leftMs)) != pdTRUE) {
+      break;
+    }
+    done++;
+  }
+  portENTER_CRITICAL(&selftestMux);
+  closed = true;
+  portEXIT_CRITICAL(&selftestMux);
+  uint32_t totalMs = (uint32_t)((hal_micros() - start) / 1000);
+
+  passed = true;
+  for (int i = 0; i < n; i++) {
+    SelfTestReport &r = reports[i];
+    if (!finished[i]) {
+      r.result = SELFTEST_TIMEOUT;
+      r.detail = 0;
+      r.ms = budgetMs;
+    }
+    if (r.result == SELFTEST_FAIL || r.result == SELFTEST_TIMEOUT) {
+      passed = false;
+    }
+    hal_printf("Self-test %-8s %-7s %4u ms (detail %ld)\n", tests[i].name, selftest_result_name(r.result),
+               (unsigned)r.ms, (long)r.detail);
+    history_log_event(EVENT_SELFTEST, r.result, r.detail, tests[i].name);
+  }
+  hal_printf("Self-test %s in %u ms (budget %u ms)\n", passed ? "passed" : "FAILED", (unsigned)totalMs,
+             (unsigned)budgetMs);
+
+  // A timed-out check is still using its peripheral (sensor.check() restarts
+  // the SHT3x periodic mode). Let it finish before the caller starts the tasks
+  // that share the driver; its result stays TIMEOUT.
+  if (done < n) {
+    hal_printf("Self-test waiting for %d late check(s)\n", n - done);
+  }
+  for (int i = 0; i < n; i++) {
+    xSemaphoreTake(exitSem, portMAX_DELAY);
+  }
+  return passed;
+}
+
+bool selftest_passed() {
+  return passed;
+}
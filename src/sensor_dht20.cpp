@@ -0,0 +1,85 @@
+#include "sensor_drivers.h"
+#include "crc.h"
+#include "hal.h"
+
+#define DHT20_STATUS_BUSY 0x80
+#define DHT20_STATUS_CALIBRATED 0x18
+#define DHT20_MEASURE_MS 80   // Datasheet: wait >75 ms after trigger
+
+bool DHT20::begin() {
+  if (!isConnected()) {
+    return false;
+  }
+  // Sensor needs 100 ms after power-up before the status byte is valid
+  hal_delay_ms(100);
+  if ((readStatus() & DHT20_STATUS_CALIBRATED) != DHT20_STATUS_CALIBRATED) {
+    const uint8_t init[] = {0xBE, 0x08, 0x00};
+    hal_i2c_write(DHT20_ADDR, init, sizeof(init));
+    hal_delay_ms(10);
+  }
+  return true;
+}
+
+bool DHT20::isConnected() {
+  return hal_i2c_probe(DHT20_ADDR);
+}
+
+int DHT20::check() {
+  if (!isConnected()) {
+    return SENSOR_ERROR_CONNECT;
+  }
+  uint8_t status = readStatus();
+  if (status & DHT20_STATUS_BUSY || (status & DHT20_STATUS_CALIBRATED) != DHT20_STATUS_CALIBRATED) {
+    return SENSOR_ERROR_STATUS;
+  }
+  return SENSOR_OK;
+}
+
+uint8_t DHT20::readStatus() {
+  uint8_t status = 0;
+  hal_i2c_read(DHT20_ADDR, &status, 1);
+  return status;
+}
+
+int DHT20::read() {
+  const uint8_t trigger[] = {0xAC, 0x33, 0x00};
+  if (!hal_i2c_write(DHT20_ADDR, trigger, sizeof(trigger))) {
+    return SENSOR_ERROR_CONNECT;
+  }
+  hal_delay_ms(DHT20_MEASURE_MS);
+
+  uint8_t buf[7];
+  int tries = 0;
+  while (true) {
+    if (!hal_i2c_read(DHT20_ADDR, buf, sizeof(buf))) {
+      return SENSOR_MISSING_BYTES;
+    }
+    if (!(buf[0] & DHT20_STATUS_BUSY)) {
+      break;
+    }
+    if (++tries >= 5) {
+      return SENSOR_ERROR_READ_TIMEOUT;
+    }
+    hal_delay_ms(10);
+  }
+
+  bool allZero = true;
+  for (int i = 0; i < 7; i++) {
+    if (buf[i] != 0) {
+      allZero = false;
+    }
+  }
+  if (allZero) {
+    return SENSOR_ERROR_BYTES_ALL_ZERO;
+  }
+  if (crc8_sensor(buf, 6) != buf[6]) {
+    return SENSOR_ERROR_CHECKSUM;
+  }
+
+  // 20-bit humidity followed by 20-bit temperature
+  uint32_t rawHum = ((uint32_t)buf[1] << 12) | ((uint32_t)buf[2] << 4) | (buf[3] >> 4);
+  uint32_t rawTemp = (((uint32_t)buf[3] & 0x0F) << 16) | ((uint32_t)buf[4] << 8) | buf[5];
+  humidity = rawHum * (100.0f / 1048576.0f);
+  temperature = rawTemp * (200.0f / 1048576.0f) - 50.0f;
+  return SENSOR_OK;
+}
@@ -0,0 +1,44 @@
+#include "sensor_drivers.h"
+#include "crc.h"
+#include "hal.h"
+
+#define SHT3X_STATUS_ALERT 0x8000
+#define SHT3X_STATUS_CHECKSUM 0x0001  // Last write had a bad checksum
+
+bool Sht3xBase::isConnected() {
+  return hal_i2c_probe(SHT3X_ADDR);
+}
+
+bool Sht3xBase::command(uint16_t cmd) {
+  const uint8_t buf[] = {(uint8_t)(cmd >> 8), (uint8_t)cmd};
+  return hal_i2c_write(SHT3X_ADDR, buf, sizeof(buf));
+}
+
+// Status register. Only accepted while idle; Sht3x<Mps>::check() stops
+// periodic acquisition around it
+int Sht3xBase::check() {
+  uint8_t buf[3];
+  if (!command(0xF32D) || !hal_i2c_read(SHT3X_ADDR, buf, sizeof(buf))) {
+    return SENSOR_ERROR_CONNECT;
+  }
+  if (crc8_sensor(buf, 2) != buf[2]) {
+    return SENSOR_ERROR_CHECKSUM;
+  }
+  uint16_t status = (uint16_t)(buf[0] << 8 | buf[1]);
+  return status & (SHT3X_STATUS_ALERT | SHT3X_STATUS_CHECKSUM) ? SENSOR_ERROR_STATUS : SENSOR_OK;
+}
+
+int Sht3xBase::fetch() {
+  uint8_t buf[6];
+  if (!hal_i2c_read(SHT3X_ADDR, buf, sizeof(buf))) {
+    return SENSOR_MISSING_BYTES;
+  }
+  if (crc8_sensor(buf, 2) != buf[2] || crc8_sensor(buf + 3, 2) != buf[5]) {
+    return SENSOR_ERROR_CHECKSUM;
+  }
+  uint16_t rawTemp = (uint16_t)(buf[0] << 8 | buf[1]);
+  uint16_t rawHum = (uint16_t)(buf[3] << 8 | buf[4]);
+  temperature = -45.0f + rawTemp * (175.0f / 65535.0f);
+  humidity = rawHum * (100.0f / 65535.0f);
+  return SENSOR_OK;
+}
@@ -0,0 +1,60 @@
+#include "sensor_drivers.h"
+#include "crc.h"
+#include "hal.h"
+
+#define SHT4X_MEASURE_HIGH 0xFD
+#define SHT4X_READ_SERIAL 0x89
+#define SHT4X_SOFT_RESET 0x94
+#define SHT4X_MEASURE_MS 9   // Datasheet: 8.3 ms max at high precision
+
+bool Sht4x::begin() {
+  if (!isConnected()) {
+    return false;
+  }
+  const uint8_t reset = SHT4X_SOFT_RESET;
+  hal_i2c_write(SHT4X_ADDR, &reset, 1);
+  hal_delay_ms(1);
+  return true;
+}
+
+bool Sht4x::isConnected() {
+  return hal_i2c_probe(SHT4X_ADDR);
+}
+
+// The SHT4x has no status register; a serial number with valid CRCs shows
+// the sensor is alive and talking
+int Sht4x::check() {
+  const uint8_t cmd = SHT4X_READ_SERIAL;
+  uint8_t buf[6];
+  if (!hal_i2c_write(SHT4X_ADDR, &cmd, 1)) {
+    return SENSOR_ERROR_CONNECT;
+  }
+  hal_delay_ms(1);
+  if (!hal_i2c_read(SHT4X_ADDR, buf, sizeof(buf))) {
+    return SENSOR_MISSING_BYTES;
+  }
+  return crc8_sensor(buf, 2) == buf[2] && crc8_sensor(buf + 3, 2) == buf[5] ? SENSOR_OK : SENSOR_ERROR_CHECKSUM;
+}
+
+int Sht4x::read() {
+  const uint8_t cmd = SHT4X_MEASURE_HIGH;
+  if (!hal_i2c_write(SHT4X_ADDR, &cmd, 1)) {
+    return SENSOR_ERROR_CONNECT;
+  }
+  hal_delay_ms(SHT4X_MEASURE_MS);
+
+  uint8_t buf[6];
+  if (!hal_i2c_read(SHT4X_ADDR, buf, sizeof(buf))) {
+    return SENSOR_MISSING_BYTES;
+  }
+  if (crc8_sensor(buf, 2) != buf[2] || crc8_sensor(buf + 3, 2) != buf[5]) {
+    return SENSOR_ERROR_CHECKSUM;
+  }
+  uint16_t rawTemp = (uint16_t)(buf[0] << 8 | buf[1]);
+  uint16_t rawHum = (uint16_t)(buf[3] << 8 | buf[4]);
+  temperature = -45.0f + rawTemp * (175.0f / 65535.0f);
+  // The RH transfer function runs slightly past 0..100, clip as the datasheet suggests
+  float rh = -6.0f + rawHum * (125.0f / 65535.0f);
+  humidity = rh < 0 ? 0 : rh > 100 ? 100 : rh;
+  return SENSOR_OK;
+}
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Build compressed firmware delta patches and send them over the console.
+
+    tools/fw_delta.py make old.bin new.bin update.hdp
+    tools/fw_delta.py make --full new.bin update.hdp
+    tools/fw_delta.py send /dev/ttyUSB0 update.hdp [--baud 115200] [--fast 2000000]
+
+old.bin must be the image the device is running (the firmware.bin it was
+flashed with); the device checks its SHA-256 before applying anything.
+A patch is an 80-byte header followed by a raw deflate stream of ops
+(see include/ota.h):
+
+    ADD    01 | src u32 | len u32 | len bytes   new = old[src..] + bytes (mod 256)
+    INSERT 02 | len u32 | len bytes            new bytes as they are
+    END    00
+
+Code that only moved, or whose embedded addresses shifted, turns into ADD
+runs that are mostly zero bytes, which deflate shrinks to almost nothing.
+`send` runs 'ota begin' and streams the patch in acknowledged frames; the
+device writes the inactive OTA slot, verifies it and reboots into it.
+Needs pyserial for `send`.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+import time
+import zlib
+
+HEADER = struct.Struct("<IIII32s32s")
+MAGIC = 0x31504448  # "HDP1"
+OP_END, OP_ADD, OP_INSERT = 0, 1, 2
+
+BLOCK = 32          # Match seed length
+MIN_MATCH = 32
+MISMATCH_RUN = 16   # An ADD run ends after this many differing bytes in a row
+
+SOF = b"\xa5\x5a"
+FRAME_OTA_DATA = 0x10
+FRAME_OTA_ACK = 0x11
+FRAME_PAYLOAD = 1024  # OTA_FRAME_MAX
+OTA_STATUS = {0: "ok", -1: "busy", -2: "bad header", -3: "patch is for a different image",
+              -4: "image does not fit the slot", -5: "corrupt compressed data", -6: "bad patch op",
+              -7: "flash write failed", -8: "image verification failed", -9: "timeout",
+              -10: "bad frame"}
+
+
+def diff(old, new):
+    """Greedy block-match diff: yields (OP_ADD, src, data) and (OP_INSERT, None, data)."""
+    index = {}
+    for off in range(0, len(old) - BLOCK + 1, 4):
+        index.setdefault(old[off:off + BLOCK], off)
+
+    literal = bytearray()
+    i = 0
+    while i < len(new):
+        src = index.get(new[i:i + BLOCK]) if i + BLOCK <= len(new) else None
+        if src is None:
+            literal.append(new[i])
+            i += 1
+            continue
+        # Extend through small differences (patched addresses, constants)
+        n, miss = 0, 0
+        while i + n < len(new) and src + n < len(old) and miss < MISMATCH_RUN:
+            miss = 0 if new[i + n] == old[src + n] else miss + 1
+            n += 1
+        n -= miss
+        if n < MIN_MATCH:
+            literal.append(new[i])
+            i += 1
+            continue
+        if literal:
+            yield OP_INSERT, None, bytes(literal)
+            literal = bytearray()
+        yield OP_ADD, src, bytes((new[i + k] - old[src + k]) & 0xFF for k in range(n))
+        i += n
+    if literal:
+        yield OP_INSERT, None, bytes(literal)
+
+
+def make_patch(old, new):
+    ops = bytearray()
+    counts = {OP_ADD: 0, OP_INSERT: 0}
+    for op, src, data in diff(old, new):
+        counts[op] += len(data)
+        if op == OP_ADD:
+            ops += struct.pack("<BII", OP_ADD, src, len(data)) + data
+        else:
+            ops += struct.pack("<BI", OP_INSERT, len(data)) + data
+    ops.append(OP_END)
+    comp = zlib.compressobj(9, zlib.DEFLATED, -15)  # Raw deflate, as tinfl expects
+    body = comp.compress(bytes(ops)) + comp.flush()
+    header = HEADER.pack(MAGIC, len(old), len(new), 0, hashlib.sha256(old).digest(),
+                         hashlib.sha256(new).digest())
+    return header + body, counts
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def send_frame(port, ftype, payload):
+    body = bytes([ftype, len(payload) & 0xFF, len(payload) >> 8]) + payload
+    crc = crc16_ccitt(body)
+    port.write(SOF + body + bytes([crc & 0xFF, crc >> 8]))
+
+
+def read_ack(port, timeout):
+    port.timeout = timeout
+    window = b""
+    while window != SOF:
+        c = port.read(1)
+        if not c:
+            raise TimeoutError("no reply from device")
+        window = (window + c)[-2:]
+    header = port.read(3)
+    length = header[1] | header[2] << 8
+    payload = port.read(length)
+    trailer = port.read(2)
+    if len(payload) != length or len(trailer) != 2 or header[0] != FRAME_OTA_ACK:
+        raise ValueError("bad reply frame")
+    if crc16_ccitt(header + payload) != (trailer[0] | trailer[1] << 8):
+        raise ValueError("reply CRC mismatch")
+    return struct.unpack("<Ii", payload)
+
+
+def switch_baud(port, baud):
+    port.reset_input_buffer()
+    port.write(b"baud %d\n" % baud)
+    port.timeout = 2
+    line = port.readline()
+    while line and not line.startswith(b"Switching to"):
+        line = port.readline()
+    if not line:
+        sys.exit("device did not switch to %d baud" % baud)
+    time.sleep(0.05)
+    port.baudrate = baud
+    port.reset_input_buffer()
+
+
+def send(args):
+    import serial
+
+    with open(args.patch, "rb") as f:
+        patch = f.read()
+    port = serial.Serial(args.port, args.baud, timeout=2)
+    port.reset_input_buffer()
+    if args.fast:
+        switch_baud(port, args.fast)
+
+    start = time.monotonic()
+    port.write(b"ota begin %d\n" % len(patch))
+    received, status = read_ack(port, 5)
+    if status != 0:
+        sys.exit("device refused: %s" % OTA_STATUS.get(status, status))
+    for off in range(0, len(patch), FRAME_PAYLOAD):
+        send_frame(port, FRAME_OTA_DATA, patch[off:off + FRAME_PAYLOAD])
+        # The first frames carry the header; the device erases the slot then
+        received, status = read_ack(port, 15 if off == 0 else 5)
+        if status != 0:
+            sys.exit("update failed at %d bytes: %s" % (received, OTA_STATUS.get(status, status)))
+        print("\r%d / %d bytes" % (received, len(patch)), end="", file=sys.stderr)
+    # Final ack once the image is verified and the boot slot switched
+    received, status = read_ack(port, 30)
+    print(file=sys.stderr)
+    if status != 0:
+        sys.exit("update failed: %s" % OTA_STATUS.get(status, status))
+    took = time.monotonic() - start
+    print("%d bytes sent in %.1f s, %.0f B/s; device is rebooting into the new image"
+          % (len(patch), took, len(patch) / max(took, 1e-3)), file=sys.stderr)
+
+
+def make(args):
+    if args.full:
+        old, (new_path, out) = b"", args.files
+    else:
+        if len(args.files) != 3:
+            sys.exit("make needs OLD NEW OUT (or --full NEW OUT)")
+        with open(args.files[0], "rb") as f:
+            old = f.read()
+        new_path, out = args.files[1:]
+    with open(new_path, "rb") as f:
+        new = f.read()
+    start = time.monotonic()
+    patch, counts = make_patch(old, new)
+    with open(out, "wb") as f:
+        f.write(patch)
+    print("%d -> %d bytes: %d patch bytes (%.1f%%), %d matched, %d literal, %.1f s"
+          % (len(old), len(new), len(patch), 100.0 * len(patch) / max(len(new), 1), counts[OP_ADD],
+             counts[OP_INSERT], time.monotonic() - start), file=sys.stderr)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    mk = sub.add_parser("make", help="build a patch")
+    mk.add_argument("--full", action="store_true", help="no base image: compressed full image")
+    mk.add_argument("files", nargs="+", help="OLD NEW OUT, or NEW OUT with --full")
+    sd = sub.add_parser("send", help="send a patch to the device")
+    sd.add_argument("port")
+    sd.add_argument("patch")
+    sd.add_argument("--baud", type=int, default=115200)
+    sd.add_argument("--fast", type=int, help="baud rate for the transfer, up to 2000000")
+    args = ap.parse_args()
+    if args.cmd == "make":
+        if args.full and len(args.files) != 2:
+            sys.exit("make --full needs NEW OUT")
+        make(args)
+    else:
+        send(args)
+
+
+if __name__ == "__main__":
+    main()
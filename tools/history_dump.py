@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Pull the telemetry log off the device and write it as CSV.
+
+    tools/history_dump.py /dev/ttyUSB0 history.csv [--baud 115200] [--fast 2000000] [--raw history.bin]
+
+Sends 'history export' on the console and decodes the binary frames
+(see include/console.h and include/history.h). --raw also keeps the
+CRC-checked 32-byte records as they are, for tools/history_replay.py.
+--fast switches the console to a higher baud rate for the export (the
+'baud' command) and back to --baud afterwards. Needs pyserial.
+"""
+import argparse
+import csv
+import struct
+import sys
+import time
+
+import serial
+
+SOF = b"\xa5\x5a"
+FRAME_HISTORY_BEGIN = 0x01
+FRAME_HISTORY_DATA = 0x02
+FRAME_HISTORY_END = 0x03
+RECORD = struct.Struct("<II20sBBH")
+SAMPLE = struct.Struct("<hhhHB11x")
+EVENT = struct.Struct("<Hhi12s")
+KPI = struct.Struct("<HhIIIHH")
+CONTROL = struct.Struct("<BBBBhhhbxI4x")
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def read_frame(port):
+    # Skip any text that was still in flight before the first frame
+    window = b""
+    while window != SOF:
+        c = port.read(1)
+        if not c:
+            raise TimeoutError("no frame from device")
+        window = (window + c)[-2:]
+    header = port.read(3)
+    ftype, length = header[0], header[1] | header[2] << 8
+    payload = port.read(length)
+    trailer = port.read(2)
+    if len(payload) != length or len(trailer) != 2:
+        raise TimeoutError("truncated frame")
+    if crc16_ccitt(header + payload) != (trailer[0] | trailer[1] << 8):
+        raise ValueError("frame CRC mismatch")
+    return ftype, payload
+
+
+def switch_baud(port, baud):
+    # The device answers at the old rate, then switches once its TX is drained
+    port.reset_input_buffer()
+    port.write(b"baud %d\n" % baud)
+    deadline = time.monotonic() + 2
+    while time.monotonic() < deadline:
+        line = port.readline()
+        if line.startswith(b"Switching to"):
+            break
+        if line.startswith(b"Baud must be"):
+            sys.exit(line.decode(errors="replace").strip())
+    else:
+        sys.exit("device did not switch to %d baud" % baud)
+    port.flush()
+    time.sleep(0.05)
+    port.baudrate = baud
+    port.reset_input_buffer()
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("port")
+    ap.add_argument("out")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--fast", type=int, help="baud rate for the export, up to 2000000")
+    ap.add_argument("--raw", help="also write the raw records to this file")
+    args = ap.parse_args()
+
+    port = serial.Serial(args.port, args.baud, timeout=2)
+    port.reset_input_buffer()
+    if args.fast:
+        switch_baud(port, args.fast)
+    port.write(b"history export\n")
+    start = time.monotonic()
+
+    ftype, payload = read_frame(port)
+    if ftype != FRAME_HISTORY_BEGIN:
+        sys.exit("unexpected frame type %d" % ftype)
+    count, first_seq, record_size, _ = struct.unpack("<IIHH", payload)
+    print("exporting %d records from seq %d" % (count, first_seq), file=sys.stderr)
+
+    raw_out = open(args.raw, "wb") if args.raw else None
+    with open(args.out, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["seq", "uptime", "type", "flags", "humidity", "temperature", "preset",
+                    "countdown", "pump_state", "code", "arg", "value", "text",
+                    "in_band_pct", "max_overshoot", "overshoot_area", "water_ml", "rh_hours",
+                    "pump_starts", "pump_minutes", "control_event", "pumps", "control_bits",
+                    "pump_run_time", "duty", "load_pct"])
+        bad = 0
+        while True:
+            ftype, payload = read_frame(port)
+            if ftype == FRAME_HISTORY_END:
+                sent, elapsed_ms = struct.unpack("<II", payload)
+                break
+            for off in range(0, len(payload), record_size):
+                raw = payload[off:off + record_size]
+                seq, uptime, body, rtype, flags, crc = RECORD.unpack(raw)
+                if crc16_ccitt(raw[:-2]) != crc:
+                    bad += 1
+                    continue
+                if raw_out:
+                    raw_out.write(raw)
+                if rtype == 1:
+                    hum, temp, preset, countdown, state = SAMPLE.unpack(body)
+                    w.writerow([seq, uptime, rtype, flags, hum / 10, temp / 10, preset / 10,
+                                countdown, state] + [""] * 17)
+                elif rtype == 3:
+                    band, overshoot, area, water, rh_hours, starts, minutes = KPI.unpack(body)
+                    w.writerow([seq, uptime, rtype, flags] + [""] * 9 +
+                               [band / 10, overshoot / 10, area / 10, water, rh_hours / 10,
+                                starts, minutes] + [""] * 6)
+                elif rtype == 4:
+                    event, state, pumps, bits, countdown, run_time, hum, duty, load = CONTROL.unpack(body)
+                    w.writerow([seq, uptime, rtype, flags, hum / 10, "", "", countdown, state]
+                               + [""] * 11 + [event, pumps, bits, run_time, duty,
+                                              round((load >> 16) / 10, 1)])
+                else:
+                    code, arg, value, text = EVENT.unpack(body)
+                    w.writerow([seq, uptime, rtype, flags, "", "", "", "", "",
+                                code, arg, value, text.rstrip(b"\0").decode(errors="replace")]
+                               + [""] * 13)
+
+    if raw_out:
+        raw_out.close()
+    took = time.monotonic() - start
+    if args.fast:
+        switch_baud(port, args.baud)
+    print("%d records (%d bad CRC) in %.1f s host / %d ms device, %.0f B/s"
+          % (sent, bad, took, elapsed_ms, sent * record_size / max(took, 1e-3)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
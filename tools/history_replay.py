@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Rebuild the controller state at any past moment from the control log.
+
+    tools/history_replay.py history.bin --trace
+    tools/history_replay.py history.bin --at 12345+90
+
+history.bin comes from tools/history_dump.py --raw. Every HISTORY_CONTROL
+record holds the full controller state after a decision, input change or
+periodic snapshot (see ControlEventCode in include/history.h). --at SEQ[+S]
+starts from the last control record at or before record SEQ and replays the
+remaining seconds: the valve/pump countdown runs down and the learned load
+follows the same integer EWMA as src/gains.cpp.
+"""
+import argparse
+import struct
+import sys
+import time
+
+RECORD = struct.Struct("<II20sBBH")
+CONTROL = struct.Struct("<BBBBhhhbxI4x")
+HISTORY_CONTROL = 4
+
+GAIN_LOAD_TAU_S = 21600  # include/gains.h
+PUMP_IDLE, PUMP_RUNNING, PUMP_WAITING = 0, 1, 2
+
+EVENTS = ["snapshot", "start", "target", "water", "duty", "valve-start", "valve-stop",
+          "pump-start", "pump-stop", "pump-abort", "wait-done", "safety"]
+STATES = ["idle", "running", "waiting"]
+BITS = [(0x01, "valve"), (0x02, "valve-has-run"), (0x04, "target"), (0x08, "water-empty"),
+        (0x10, "pump")]
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def load_records(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    records = []
+    for off in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        raw = data[off:off + RECORD.size]
+        seq, uptime, body, rtype, flags, crc = RECORD.unpack(raw)
+        if crc16_ccitt(raw[:-2]) == crc:
+            records.append((seq, uptime, rtype, body))
+    return records
+
+
+def decode(body):
+    event, state, pumps, bits, countdown, run_time, hum, duty, load = CONTROL.unpack(body)
+    return {"event": event, "pump_state": state, "pumps": pumps, "bits": bits,
+            "countdown": countdown, "pump_run_time": run_time, "humidity": hum, "duty": duty,
+            "load_q16": load}
+
+
+def ctrunc_div(a, b):
+    # C integer division truncates toward zero
+    q = abs(a) // b
+    return q if a >= 0 else -q
+
+
+def advance(st, seconds):
+    st = dict(st)
+    counting = st["bits"] & 0x01 or st["pump_state"] in (PUMP_RUNNING, PUMP_WAITING)
+    if counting:
+        st["countdown"] = max(0, st["countdown"] - seconds)
+    target = (1000 << 16) if st["pumps"] > 0 else 0
+    load = st["load_q16"]
+    for _ in range(seconds):
+        load += ctrunc_div(target - load, GAIN_LOAD_TAU_S)
+    st["load_q16"] = load
+    return st
+
+
+def describe(st):
+    bits = ",".join(name for mask, name in BITS if st["bits"] & mask) or "-"
+    duty = "standalone" if st["duty"] < 0 else "duty %d%%" % st["duty"]
+    return ("%-11s %-7s pumps %d countdown %3ds run %3ds  RH %5.1f%%  %s  load %.1f%%  [%s]"
+            % (EVENTS[st["event"]] if st["event"] < len(EVENTS) else st["event"],
+               STATES[st["pump_state"]] if st["pump_state"] < len(STATES) else st["pump_state"],
+               st["pumps"], st["countdown"], st["pump_run_time"], st["humidity"] / 10, duty,
+               (st["load_q16"] >> 16) / 10, bits))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("raw")
+    ap.add_argument("--at", help="SEQ[+SECONDS]: state at a record, or seconds after it")
+    ap.add_argument("--trace", action="store_true", help="print every control record")
+    args = ap.parse_args()
+
+    start = time.monotonic()
+    records = load_records(args.raw)
+
+    if args.trace:
+        for seq, uptime, rtype, body in records:
+            if rtype == HISTORY_CONTROL:
+                print("%8d %8ds  %s" % (seq, uptime, describe(decode(body))))
+
+    if args.at:
+        seq_s, _, extra = args.at.partition("+")
+        want, extra = int(seq_s), int(extra or 0)
+        target = next((r for r in records if r[0] >= want), None)
+        if target is None or target[0] != want:
+            sys.exit("record %d not in the log" % want)
+        base = None
+        prev_uptime = 0
+        for seq, uptime, rtype, body in records:
+            if seq > want:
+                break
+            if uptime < prev_uptime:
+                base = None  # Rebooted, the old state no longer applies
+            prev_uptime = uptime
+            if rtype == HISTORY_CONTROL:
+                base = (seq, uptime, decode(body))
+        if base is None:
+            sys.exit("no control record before %d in this boot" % want)
+        seconds = target[1] - base[1] + extra
+        st = advance(base[2], seconds)
+        print("from record %d (%ds earlier):" % (base[0], seconds))
+        print("  %s" % describe(st))
+
+    print("%d records replayed in %.1f ms" % (len(records), (time.monotonic() - start) * 1000),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()